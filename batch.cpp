@@ -0,0 +1,404 @@
+#include "voters.h"
+#include "terminal.h"
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
+
+using namespace std;
+
+// Вывод результата запроса пакетного режима: запись в файл (формат по расширению)
+// или подсчет строк, если файл не указан
+bool batchOutput(sqlite3_stmt* stmt, const string& filename, const string& kind, const string& param) {
+    if (filename.empty()) {
+        long long count = 0;
+        while (sqlite3_step(stmt) == SQLITE_ROW) ++count;
+        cout << u8"Найдено строк: " << count << endl;
+        return true;
+    }
+    size_t dot = filename.rfind('.');
+    string ext = dot == string::npos ? "" : filename.substr(dot);
+    int format = ext == ".csv" ? FormatCsv : (ext == ".json" ? FormatJson : (ext == ".ndjson" ? FormatNdjson : FormatTable));
+    ResultCursor rows(stmt, false);
+    if (ext == ".tbl") {
+        long long count = writeFixedReport(filename, rows);
+        if (count < 0) return false;
+        cout << u8"Результат сохранен в файл: " << filename << u8" (записей: " << count << ")" << endl;
+        if (!kind.empty()) registerReport(sqlite3_db_handle(stmt), filename, kind, param, rows.position());
+        return true;
+    }
+    if (format != FormatTable) {
+        long long count = exportRows(filename, rows, format);
+        if (count < 0) return false;
+        cout << u8"Результат сохранен в файл: " << filename << u8" (строк: " << count << ")" << endl;
+        return true;
+    }
+    if (!write(filename, rows, false)) return false;
+    cout << endl;
+    if (!kind.empty()) registerReport(sqlite3_db_handle(stmt), filename, kind, param, rows.position());
+    return true;
+}
+
+// Выполнение одной операции пакетного режима на общем подключении.
+// Операции:
+//   open <база данных>                         - открыть другую базу данных
+//   import <файл>                              - импорт избирателей из файла
+//   search street|year|city <значение> [файл]  - поиск по улице, году или городу рождения
+//   sort <столбец>[,-столбец...] [файл]        - сортировка ("-" - по убыванию)
+//   export <файл>                              - выгрузка всей базы данных
+//   delete <ID>                                - удаление пользователя
+//   sync                                       - обновление файлов отчетов по журналу
+//   stats                                      - число избирателей по статистике
+//   profile <профиль>                          - профиль хранения (standard, interactive, bulk, analytics)
+bool runBatchCommand(unique_ptr<SQLiteDB>& db, const vector<string>& args, bool transaction) {
+    const string& op = args[0];
+    if (op == "open" && args.size() == 2) {
+        if (db && transaction) {
+            if (sqlite3_exec(db->get(), "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+                cerr << u8"Ошибка фиксации транзакции: " << sqlite3_errmsg(db->get()) << endl;
+                return false;
+            }
+            if (file_undo) file_undo->commit();
+        }
+        db.reset(new SQLiteDB(args[1]));
+        // Новая база создается, как в create_db: ночные задания могут начинать с пустого файла
+        if (sqlite3_exec(db->get(), users_table_sql, nullptr, nullptr, nullptr) != SQLITE_OK) {
+            cerr << u8"Ошибка создания таблицы: " << sqlite3_errmsg(db->get()) << endl;
+            return false;
+        }
+        if (!ensureJournal(db->get()) || !ensureIndexes(db->get())) return false;
+        if (transaction) sqlite3_exec(db->get(), "BEGIN;", nullptr, nullptr, nullptr);
+        return true;
+    }
+    if (!db) {
+        cerr << u8"База данных не открыта" << endl;
+        return false;
+    }
+    sqlite3* handle = db->get();
+    if (op == "import" && args.size() == 2) {
+        return importVoters(handle, args[1]);
+    }
+    if (op == "search" && (args.size() == 3 || args.size() == 4)) {
+        string file = args.size() == 4 ? args[3] : "";
+        if (args[1] == "street") {
+            SQLiteStmt stmt(handle, "SELECT * FROM users WHERE adres LIKE ?;");
+            string pattern = "%" + args[2] + "%";
+            sqlite3_bind_text(stmt.get(), 1, pattern.c_str(), -1, SQLITE_TRANSIENT);
+            return batchOutput(stmt.get(), file, "street", args[2]);
+        }
+        if (args[1] == "year") {
+            if (!isDigitsOnly(args[2]) || args[2].length() != 4) {
+                cerr << u8"Год рождения должен быть четырехзначным числом" << endl;
+                return false;
+            }
+            SQLiteStmt stmt(handle, "SELECT * FROM users WHERE godrozh = ?;");
+            sqlite3_bind_int(stmt.get(), 1, stoi(args[2]));
+            return batchOutput(stmt.get(), file, "year", args[2]);
+        }
+        if (args[1] == "city") {
+            SQLiteStmt stmt(handle, "SELECT * FROM users WHERE mesto = ?;");
+            sqlite3_bind_text(stmt.get(), 1, args[2].c_str(), -1, SQLITE_TRANSIENT);
+            return batchOutput(stmt.get(), file, "city", args[2]);
+        }
+    }
+    if (op == "sort" && (args.size() == 2 || args.size() == 3)) {
+        vector<SortKey> keys;
+        stringstream ss(args[1]);
+        string column;
+        while (getline(ss, column, ',')) {
+            bool ascending = column.empty() || column[0] != '-';
+            if (!ascending) column.erase(0, 1);
+            auto it = find(begin(sort_columns), end(sort_columns), column);
+            if (it == end(sort_columns)) {
+                cerr << u8"Неизвестный столбец сортировки: " << column << endl;
+                return false;
+            }
+            keys.push_back({ static_cast<int>(it - begin(sort_columns)), ascending });
+        }
+        SQLiteStmt stmt(handle, "SELECT * FROM users ORDER BY " + orderByClause(keys) + ";");
+        return batchOutput(stmt.get(), args.size() == 3 ? args[2] : "", "sorted", orderByClause(keys));
+    }
+    if (op == "export" && args.size() == 2) {
+        SQLiteStmt stmt(handle, "SELECT * FROM users;");
+        return batchOutput(stmt.get(), args[1], "", "");
+    }
+    if (op == "delete" && args.size() == 2 && isDigitsOnly(args[1])) {
+        deleteUserById(handle, stoi(args[1]));
+        return true;
+    }
+    if (op == "sync" && args.size() == 1) {
+        cout << u8"Обновлено файлов отчетов: " << syncReports(handle, "") << endl;
+        return true;
+    }
+    if (op == "profile" && args.size() == 2) {
+        const StorageProfile& p = findStorageProfile(args[1]);
+        if (args[1] != p.name) {
+            cerr << u8"Неизвестный профиль хранения: " << args[1] << endl;
+            return false;
+        }
+        // VACUUM невозможен внутри транзакции - в пакете с транзакцией профиль действует только на подключение
+        if (transaction) return applyStorageProfile(handle, p, false);
+        return setStorageProfile(handle, p);
+    }
+    if (op == "stats" && args.size() == 1) {
+        cout << u8"Всего избирателей: " << syncStats(handle).total << endl;
+        return true;
+    }
+    cerr << u8"Неизвестная операция или неверные аргументы: " << op << endl;
+    return false;
+}
+
+// Пакетный режим: операции выполняются подряд на одном подключении к базе данных,
+// при transaction - в одной транзакции, которая откатывается при первой ошибке.
+// Для каждой операции выводится время выполнения.
+bool runBatch(const string& db_name, const vector<string>& lines, bool transaction) {
+    // Файлы отчетов и индексов, измененные в транзакции, откатываются вместе с ней
+    FileUndo undo;
+    if (transaction) file_undo = &undo;
+    unique_ptr<SQLiteDB> db;
+    auto rollback = [&]() {
+        if (db) sqlite3_exec(db->get(), "ROLLBACK;", nullptr, nullptr, nullptr);
+        undo.rollback();
+        file_undo = nullptr;
+        // Индексы в памяти могли учесть отмененные изменения
+        bitmap_index.db_name.clear();
+    };
+    auto started = chrono::steady_clock::now();
+    if (!runBatchCommand(db, { "open", db_name }, transaction)) {
+        rollback();
+        return false;
+    }
+    int step = 0;
+    for (const auto& raw : lines) {
+        string line = trim(raw);
+        if (line.empty() || line[0] == '#') continue;
+        vector<string> args = splitCommand(line);
+        ++step;
+        cout << "[" << step << "] " << line << endl;
+        auto step_started = chrono::steady_clock::now();
+        bool ok = runBatchCommand(db, args, transaction);
+        auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - step_started).count();
+        cout << "[" << step << "] " << (ok ? u8"выполнено" : u8"ошибка") << u8" за " << elapsed << u8" мс" << endl;
+        if (!ok) {
+            if (transaction) {
+                rollback();
+                cout << u8"Изменения пакета отменены" << endl;
+            }
+            cout << u8"Выполнение пакета прервано" << endl;
+            return false;
+        }
+    }
+    if (transaction) {
+        if (sqlite3_exec(db->get(), "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+            cerr << u8"Ошибка фиксации транзакции: " << sqlite3_errmsg(db->get()) << endl;
+            rollback();
+            cout << u8"Изменения пакета отменены" << endl;
+            return false;
+        }
+        undo.commit();
+        file_undo = nullptr;
+    }
+    auto total = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
+    cout << u8"Пакет выполнен: операций " << step << u8", общее время " << total << u8" мс" << endl;
+    return true;
+}
+
+// Проверка атомарности обновления отчетов с имитацией сбоя (--crashtest).
+// Создается база crashtest.db с отчетами, в базу вносятся изменения, затем
+// обновление отчетов по журналу (пакетная операция sync) запускается в отдельном
+// процессе, который аварийно завершается на 1-й, 2-й, ... точке записи.
+// После каждого сбоя каждый переписываемый отчет должен полностью совпадать
+// со старым или с новым содержимым, а повторное обновление - приводить все отчеты
+// к новому. Отчет .tbl меняется на месте по записям: прерванный на середине файл
+// должен нести пометку незавершенного изменения в заголовке и открываться
+// с восстановлением (см. FixedReport::open).
+// Отчет .tbl, измененный на месте не до конца: заголовок помечен, а копия файла
+// открывается с восстановлением
+bool fixedReportRecovers(const string& text) {
+    if (text.size() < static_cast<size_t>(fixed_record_size) || text[static_cast<size_t>(fixed_record_size) - 2] != '*') return false;
+    const string copy = "crashtest_check.tbl";
+    {
+        ofstream file(copy, ios::binary | ios::trunc);
+        file.write(text.data(), text.size());
+    }
+    FixedReport report;
+    bool ok = report.open(copy) && report.close();
+    remove(copy.c_str());
+    return ok;
+}
+
+bool crashTest(const string& self) {
+    const string db_name = "crashtest.db";
+    const vector<string> reports = { "crashtest_city.txt", "crashtest_year.txt", "crashtest_sorted.txt", "crashtest_city.tbl" };
+    const vector<string> state_files = { db_name, db_name + ".bitmaps" };
+    auto readAll = [](const string& name) {
+        ifstream file(name, ios::binary);
+        return string((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    };
+    auto cleanUp = [&]() {
+        for (const auto& name : state_files) remove(name.c_str());
+        for (const char* suffix : { "-journal", "-wal", "-shm" }) remove((db_name + suffix).c_str());
+        for (const auto& name : reports) {
+            remove(name.c_str());
+            remove(FileBatch::tempName(name).c_str());
+        }
+    };
+    // Запуск обновления отчетов в отдельном процессе; возвращает код завершения
+    auto runSync = [&](int crash_at) {
+        string command = "\"" + self + "\" " + (crash_at > 0 ? "--crash-at " + to_string(crash_at) + " " : "")
+            + db_name + " -e sync";
+#ifdef _WIN32
+        return system(("\"" + command + " > nul 2>&1\"").c_str());
+#else
+        int rc = system((command + " > /dev/null 2>&1").c_str());
+        return WIFEXITED(rc) ? WEXITSTATUS(rc) : -1;
+#endif
+    };
+
+    cleanUp();
+    ostringstream quiet;
+    streambuf* console = cout.rdbuf(quiet.rdbuf());
+    {
+        SQLiteDB db(db_name);
+        sqlite3_exec(db.get(), users_table_sql, nullptr, nullptr, nullptr);
+        ensureJournal(db.get());
+        ensureIndexes(db.get());
+        generateVoters(db.get(), 3000, 47);
+    }
+    bool prepared = runBatch(db_name, { u8"search city Москва crashtest_city.txt", "search year 1980 crashtest_year.txt",
+        "sort familiya,-godrozh crashtest_sorted.txt", u8"search city Москва crashtest_city.tbl" }, false);
+    // Изменения, которые затронут все отчеты: удаления, добавления и изменение записи
+    if (prepared) {
+        SQLiteDB db(db_name);
+        prepared = sqlite3_exec(db.get(),
+            u8"DELETE FROM users WHERE id % 97 = 0;"
+            u8"INSERT INTO users (familiya, imya, otchestvo, godrozh, adres, mesto) "
+            u8"SELECT 'Андреев', imya, otchestvo, 1980, adres, 'Москва' FROM users WHERE id % 89 = 0;"
+            u8"UPDATE users SET adres = 'Ул. Новая, д. 1, кв. 1' WHERE id % 83 = 0;",
+            nullptr, nullptr, nullptr) == SQLITE_OK;
+    }
+    cout.rdbuf(console);
+    if (!prepared) {
+        cerr << u8"Не удалось подготовить базу данных для проверки" << endl;
+        return false;
+    }
+
+    // Снимок состояния до обновления: база данных, индексы и отчеты
+    map<string, string> snapshot;
+    for (const auto& name : state_files) snapshot[name] = readAll(name);
+    vector<string> old_reports, new_reports;
+    vector<long long> old_times;
+    for (const auto& name : reports) {
+        long long size = 0, mtime = 0;
+        fileStamp(name, size, mtime);
+        old_reports.push_back(readAll(name));
+        old_times.push_back(mtime);
+    }
+    auto restore = [&]() {
+        for (const char* suffix : { "-journal", "-wal", "-shm" }) remove((db_name + suffix).c_str());
+        for (const auto& entry : snapshot) {
+            ofstream file(entry.first, ios::binary | ios::trunc);
+            file.write(entry.second.data(), entry.second.size());
+        }
+        for (size_t i = 0; i < reports.size(); ++i) {
+            {
+                ofstream file(reports[i], ios::binary | ios::trunc);
+                file.write(old_reports[i].data(), old_reports[i].size());
+            }
+            // Отметка файла в снимке базы должна совпасть с восстановленным отчетом
+            setFileTime(reports[i], old_times[i]);
+            remove(FileBatch::tempName(reports[i]).c_str());
+        }
+    };
+
+    if (runSync(0) != 0) {
+        cerr << u8"Обновление отчетов без сбоя завершилось ошибкой" << endl;
+        return false;
+    }
+    for (const auto& name : reports) new_reports.push_back(readAll(name));
+    for (size_t i = 0; i < reports.size(); ++i) {
+        if (new_reports[i] == old_reports[i]) {
+            cerr << u8"Изменения не затронули отчет " << reports[i] << endl;
+            return false;
+        }
+    }
+
+    bool ok = true;
+    int point = 1;
+    for (;; ++point) {
+        restore();
+        int rc = runSync(point);
+        if (rc == 0) break;    // Точки сбоя закончились - обновление прошло целиком
+        if (rc != 3) {
+            cerr << u8"Точка " << point << u8": неожиданный код завершения " << rc << endl;
+            ok = false;
+            break;
+        }
+        int old_count = 0, new_count = 0, interrupted = 0;
+        string broken;
+        for (size_t i = 0; i < reports.size(); ++i) {
+            string text = readAll(reports[i]);
+            if (text == new_reports[i]) ++new_count;
+            else if (text == old_reports[i]) ++old_count;
+            else if (reports[i].compare(reports[i].size() - 4, 4, ".tbl") == 0 && fixedReportRecovers(text)) ++interrupted;
+            else broken += " " + reports[i];
+        }
+        int recovered = runSync(0);
+        for (size_t i = 0; i < reports.size(); ++i) {
+            if (readAll(reports[i]) != new_reports[i]) broken += " " + reports[i] + u8" (после повторного обновления)";
+        }
+        cout << u8"Сбой в точке " << point << u8": старых отчетов " << old_count << u8", новых " << new_count;
+        if (interrupted > 0) cout << u8", прерванных на месте " << interrupted;
+        if (recovered != 0 || !broken.empty()) {
+            cout << u8" - ОШИБКА:" << broken << endl;
+            ok = false;
+        }
+        else {
+            cout << u8", после повторного обновления все отчеты новые" << endl;
+        }
+    }
+    cleanUp();
+    cout << (ok ? u8"Проверка пройдена" : u8"Проверка не пройдена") << u8": точек сбоя " << point - 1 << endl;
+    return ok;
+}
+
+// Пакетный режим: операции над базой данных без интерактивного меню (см. runBatchCommand)
+// Параметры командной строки:
+//   <база данных> [--transaction] <файл сценария | - | -e операция...>
+//                                              - выполнение операций сценария
+//   --crashtest                                - проверка атомарности обновления отчетов
+//   --crash-at <N> <параметры>                 - аварийное завершение на N-й точке записи
+int main(int argc, char* argv[]) {
+    initTerminal();
+    if (argc > 2 && string(argv[1]) == "--crash-at") {
+        crash_countdown = atoi(argv[2]);
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+    if (argc > 1 && string(argv[1]) == "--crashtest") {
+        return crashTest(argv[0]) ? 0 : 1;
+    }
+    if (argc < 3) {
+        cerr << u8"Использование: " << argv[0] << u8" <база данных> [--transaction] <файл сценария | - | -e операция...>" << endl;
+        return 1;
+    }
+    int next = 2;
+    bool transaction = string(argv[next]) == "--transaction";
+    if (transaction) ++next;
+    vector<string> lines;
+    if (next < argc && string(argv[next]) == "-e") {
+        lines.assign(argv + next + 1, argv + argc);
+    }
+    else if (next < argc) {
+        ifstream script;
+        if (string(argv[next]) != "-") script.open(argv[next]);
+        istream& in = string(argv[next]) == "-" ? cin : script;
+        if (!in) {
+            cerr << u8"Ошибка открытия файла сценария: " << argv[next] << endl;
+            return 1;
+        }
+        string line;
+        while (getline(in, line)) lines.push_back(line);
+    }
+    return runBatch(argv[1], lines, transaction) ? 0 : 1;
+}
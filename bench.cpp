@@ -0,0 +1,127 @@
+#include "voters.h"
+#include "terminal.h"
+
+using namespace std;
+
+// Замеры производительности ядра на синтетической базе данных.
+// Программа не требует консоли и запускается на сервере, в том числе под
+// профилировщиком (perf, valgrind); при сборке с VOTERS_PROFILE после каждого
+// замера выводится сводка по памяти.
+// Параметры командной строки:
+//   [число избирателей] [каталог для файлов]   - по умолчанию 100000 и текущий каталог
+int main(int argc, char* argv[]) {
+    initTerminal();
+    int rows = argc > 1 ? atoi(argv[1]) : 100000;
+    string dir = argc > 2 ? string(argv[2]) + "/" : "";
+    if (rows <= 0) {
+        cerr << u8"Использование: " << argv[0] << u8" [число избирателей] [каталог для файлов]" << endl;
+        return 1;
+    }
+    const string db_name = dir + "bench.db";
+    const string import_db_name = dir + "bench_import.db";
+    const string report = dir + "bench_report.txt";
+    const string sorted_report = dir + "bench_sorted.txt";
+    const string city_report = dir + "bench_city.txt";
+    const string import_file = dir + "bench_import.txt";
+    const vector<string> files = { db_name, db_name + ".bitmaps", import_db_name, import_db_name + ".bitmaps",
+        report, sorted_report, city_report, import_file, dir + "bench.csv", dir + "bench.json", dir + "bench.tbl" };
+    for (const auto& name : files) remove(name.c_str());
+
+    const int name_width = 34;
+    cout << u8"Замер" << padding(name_width, 5) << u8" | время, мс" << endl;
+    auto step = [&](const string& name, long long ms) {
+        cout << name << padding(name_width, utf8Length(name)) << " | " << ms << endl;
+#ifdef VOTERS_PROFILE
+        profileReport();
+#endif
+    };
+    // Вывод отчетов функциями ядра идет в cout - на время замеров он отключается
+    ostringstream quiet;
+    auto silent = [&](function<void()> action) {
+        streambuf* console = cout.rdbuf(quiet.rdbuf());
+        action();
+        cout.rdbuf(console);
+        quiet.str("");
+    };
+
+    SQLiteDB db(db_name);
+    sqlite3_exec(db.get(), users_table_sql, nullptr, nullptr, nullptr);
+    ensureJournal(db.get());
+    ensureIndexes(db.get());
+    step(u8"генерация " + to_string(rows) + u8" записей", measureMs([&]() { generateVoters(db.get(), rows, 48); }));
+
+    step(u8"индексы: битовые карты и годы", measureMs([&]() { syncBitmaps(db.get()); }));
+    step(u8"статистика (HLL, CMS)", measureMs([&]() { rebuildStats(db.get()); }));
+    int64_t year_total = 0;
+    step(u8"100000 запросов к индексу годов", measureMs([&]() {
+        for (int i = 0; i < 100000; ++i) year_total += year_index.countRange(1940 + i % 66, 2005);
+    }));
+
+    step(u8"отчет по всей базе (таблица)", measureMs([&]() {
+        SQLiteStmt stmt(db.get(), "SELECT * FROM users;");
+        ResultCursor cursor(stmt.get(), false);
+        silent([&]() { write(report, cursor, false); });
+    }));
+    step(u8"поиск по городу и отчет", measureMs([&]() {
+        SQLiteStmt stmt(db.get(), "SELECT * FROM users WHERE mesto = ?;");
+        sqlite3_bind_text(stmt.get(), 1, u8"Москва", -1, SQLITE_STATIC);
+        ResultCursor cursor(stmt.get(), false);
+        silent([&]() { write(city_report, cursor, false); });
+        registerReport(db.get(), city_report, "city", u8"Москва", cursor.position());
+    }));
+    const vector<SortKey> keys = { { 0, true }, { 3, false } };
+    step(u8"сортировка в SQLite и отчет", measureMs([&]() {
+        SQLiteStmt stmt(db.get(), "SELECT * FROM users ORDER BY " + orderByClause(keys) + ";");
+        ResultCursor cursor(stmt.get(), false);
+        silent([&]() { write(sorted_report, cursor, false); });
+    }));
+    step(u8"внешняя сортировка файла отчета", measureMs([&]() { externalSortReport(report, sorted_report, keys); }));
+    vector<User> users;
+    {
+        SQLiteStmt stmt(db.get(), "SELECT * FROM users;");
+        ResultCursor cursor(stmt.get(), false);
+        cursor.forEach([&](const User& u) { users.push_back(u); return true; });
+    }
+    step(u8"сортировка в памяти", measureMs([&]() { sortUsers(users, keys); }));
+
+    const int formats[] = { FormatCsv, FormatJson, FormatFixed };
+    const char* format_names[] = { "CSV", "JSON", u8"фиксированная ширина" };
+    for (int i = 0; i < 3; ++i) {
+        string filename = dir + "bench" + formatExtension(formats[i]);
+        step(u8"выгрузка " + string(format_names[i]), measureMs([&]() {
+            SQLiteStmt stmt(db.get(), "SELECT * FROM users;");
+            ResultCursor cursor(stmt.get(), false);
+            silent([&]() {
+                if (formats[i] == FormatFixed) writeFixedReport(filename, cursor);
+                else exportRows(filename, cursor, formats[i]);
+            });
+        }));
+    }
+
+    // Изменение 1% записей и обновление отчета по журналу
+    sqlite3_exec(db.get(), u8"UPDATE users SET mesto = 'Москва' WHERE id % 100 = 0;", nullptr, nullptr, nullptr);
+    step(u8"обновление отчета по журналу", measureMs([&]() { silent([&]() { syncReports(db.get(), ""); }); }));
+    step(u8"обновление индексов по журналу", measureMs([&]() { syncBitmaps(db.get()); }));
+
+    {
+        // Адрес в файле импорта задается как при ручном вводе: "Ленина 64 5"
+        ofstream out(import_file, ios::binary);
+        for (const auto& u : users) {
+            istringstream parts(u.adres.substr(u.adres.find(',') + 1));
+            string skip;
+            int dom = 0, kv = 0;
+            parts >> skip >> dom >> skip >> skip >> kv;
+            out << u.familiya << ';' << u.imya << ';' << u.otchestvo << ';' << u.godrozh << ';'
+                << streetOf(u.adres) << ' ' << dom << ' ' << kv << ';' << u.mesto << '\n';
+        }
+    }
+    SQLiteDB import_db(import_db_name);
+    sqlite3_exec(import_db.get(), users_table_sql, nullptr, nullptr, nullptr);
+    ensureJournal(import_db.get());
+    ensureIndexes(import_db.get());
+    step(u8"импорт из файла", measureMs([&]() { silent([&]() { importVoters(import_db.get(), import_file); }); }));
+
+    cout << u8"Контрольная сумма индекса годов: " << year_total << endl;
+    for (const auto& name : files) remove(name.c_str());
+    return 0;
+}
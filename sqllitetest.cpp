@@ -1,1216 +1,2315 @@
-﻿#include <iostream>
-#include <iomanip>
-#include <fstream>
-#include <string>
-#include <vector>
-#include <algorithm>
-#include <sstream>
-#include <Windows.h>
-#include "sqlite/sqlite3.h"
-
-using namespace std;
-
-// Структура для хранения последних параметров поиска и имен файлов
-struct LastSearch {
-    int year = -1;
-    string city;
-    string street;
-    string last_year_file;   // Имя файла для года
-    string last_street_file; // Имя файла для улицы
-    string last_city_file;   // Имя файла для города
-} last_search;
-
-// Класс для управления подключением к базе данных SQLite
-class SQLiteDB {
-    sqlite3* db;
-public:
-    SQLiteDB(const string& name) {
-        if (sqlite3_open(name.c_str(), &db) != SQLITE_OK) {
-            cerr << u8"Ошибка SQLite: " << sqlite3_errmsg(db) << endl;
-            exit(1);
-        }
-    }
-    ~SQLiteDB() { sqlite3_close(db); }
-    sqlite3* get() const { return db; }
-};
-
-// Класс для управления подготовленным запросом SQLite
-class SQLiteStmt {
-    sqlite3_stmt* stmt;
-public:
-    SQLiteStmt(sqlite3* db, const string& sql) {
-        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-            cerr << u8"Ошибка SQLite: " << sqlite3_errmsg(db) << endl;
-            exit(1);
-        }
-    }
-    ~SQLiteStmt() { sqlite3_finalize(stmt); }
-    sqlite3_stmt* get() const { return stmt; }
-};
-
-// Функция для получения выбора пользователя из меню с проверкой ввода
-int getMenuChoice(const string& prompt) {
-    int choice;
-    cout << prompt;
-    cin >> choice;
-    while (cin.fail() || cin.peek() != '\n') {
-        cout << u8"Некорректный выбор\nПовторите ввод: ";
-        cin.clear();
-        cin.ignore(10000, '\n');
-        cin >> choice;
-    }
-    return choice;
-}
-
-// Проверка, что строка содержит только русские буквы
-bool isRussianLettersOnly(const string& str) {
-    if (str.empty()) return false;
-    for (int i = 0; i < str.length(); ) {
-        unsigned char c = str[i];
-        if (c == ' ') {
-            i++;
-            continue;
-        }
-        if (i + 1 >= str.length()) return false; 
-        unsigned char next = str[i + 1];
-
-        if (c == 0xD0 && ((next >= 0x90 && next <= 0xBF) || next == 0x81)) {
-            i += 2; 
-        }
-        else if (c == 0xD1 && ((next >= 0x80 && next <= 0x8F) || next == 0x91)) {
-            i += 2; 
-        }
-        else {
-            return false; 
-        }
-    }
-    return true;
-}
-
-bool firstTrue(const string& str) {
-    unsigned char byte1 = static_cast<unsigned char>(str[0]);
-    unsigned char byte2 = (str.size() > 1) ? static_cast<unsigned char>(str[1]) : 0;
-
-    bool firstCharValid = false;
-    if (byte1 == 0xD0) {
-        // Проверяем А-Я (кроме Ё)
-        if (byte2 >= 0x90 && byte2 <= 0xAF) {
-            firstCharValid = true;
-        }
-        // Проверяем Ё отдельно
-        else if (byte2 == 0x81) {
-            firstCharValid = true;
-        }
-    }
-    if (!firstCharValid) {
-        return false;
-    }
-    return true;
-}
-
-// Проверка, что фамилия содержит русский буквы и дефис
-bool isCorrectSecondname(const string& str) {
-    if (str.empty()) return false;
-    for (int i = 0; i < str.length(); ) {
-        unsigned char c = str[i];
-        // Дефис разрешён, но не в начале и не в конце
-        if (c == 0x2D) {
-            if (i == 0 || i == str.length() - 1) {  // Дефис в начале или конце — ошибка
-                return false;
-            }
-            i++;  // Переходим к следующему символу
-            continue;
-        }
-        if (i + 1 >= str.length()) return false;
-        unsigned char next = str[i + 1];
-
-        if (c == 0xD0 && ((next >= 0x90 && next <= 0xBF) || next == 0x81)) {
-            i += 2;
-        }
-        else if (c == 0xD1 && ((next >= 0x80 && next <= 0x8F) || next == 0x91)) {
-            i += 2;
-        }
-        else {
-            return false;
-        }
-    }
-    return true;
-}
-
-// Проверка, что строка содержит только цифры
-bool isDigitsOnly(const string& str) {
-    for (char c : str) {
-        if (!isdigit(c)) {
-            return false;
-        }
-    }
-    return !str.empty();
-}
-
-// Проверка, что строка является корректным именем файла
-bool isValidFilename(const string& str) {
-    if (str.empty()) return false;
-    for (int i = 0; i < str.length(); ) {
-        unsigned char c = str[i];
-        if (c == 0x2E) {
-            i += 1;
-        }
-        else if (c == 0x5F) {
-            i += 1;
-        }
-        else if (c >= 0x30 && c <= 0x39) {
-            i += 1;
-        }
-        else if ((c >= 0x41 && c <= 0x5A) || (c >= 0x61 && c <= 0x7A)) {
-            i += 1;
-        }
-        else if (i + 1 < str.length()) { 
-            unsigned char next = str[i + 1];
-            if (c == 0xD0 && ((next >= 0x90 && next <= 0xBF) || next == 0x81)) {
-                i += 2; 
-            }
-            else if (c == 0xD1 && ((next >= 0x80 && next <= 0x8F) || next == 0x91)) {
-                i += 2; 
-            }
-            else {
-                return false; 
-            }
-        }
-        else {
-            return false; 
-        }
-    }
-    return true;
-}
-
-// Вывод заголовка таблицы в файл
-void printTableHeader(ostream& out) {
-    out << left << setw(2) << u8"ID" << " | " << left << setw(27) << u8"Фамилия" << " | "
-        << left << setw(13) << u8"Имя" << " | " << left << setw(23) << u8"Отчество" << " | "
-        << left << setw(10) << u8"Год рождения" << " | " << left << setw(33) << u8"Адрес" << " | "
-        << left << setw(15) << u8"Место" << endl;
-    out << u8"--------------------------------------------------------------------------------------------------------------------------" << endl;
-}
-
-// Вывод строки данных в файл
-void printRow(ostream& out, int id, const string& familiya, const string& imya, const string& otchestvo, int godrozh, const string& adres, const string& mesto) {
-    int lenFamiliya = 0;
-    if (familiya != "") {
-        const unsigned char* ptr = reinterpret_cast<const unsigned char*>(familiya.c_str());
-        while (*ptr) {
-            if ((*ptr & 0xC0) != 0x80) lenFamiliya++;
-            ptr++;
-        }
-    }
-
-    int lenImya = 0;
-    if (imya != "") {
-        const unsigned char* ptr = reinterpret_cast<const unsigned char*>(imya.c_str());
-        while (*ptr) {
-            if ((*ptr & 0xC0) != 0x80) lenImya++;
-            ptr++;
-        }
-    }
-
-    int lenOtchestvo = 0;
-    if (otchestvo != "") {
-        const unsigned char* ptr = reinterpret_cast<const unsigned char*>(otchestvo.c_str());
-        while (*ptr) {
-            if ((*ptr & 0xC0) != 0x80) lenOtchestvo++;
-            ptr++;
-        }
-    }
-
-    int lenAdres = 0;
-    if (adres != "") {
-        const unsigned char* ptr = reinterpret_cast<const unsigned char*>(adres.c_str());
-        while (*ptr) {
-            if ((*ptr & 0xC0) != 0x80) lenAdres++;
-            ptr++;
-        }
-    }
-
-    int lenMesto = 0;
-    if (mesto != "") {
-        const unsigned char* ptr = reinterpret_cast<const unsigned char*>(mesto.c_str());
-        while (*ptr) {
-            if ((*ptr & 0xC0) != 0x80) lenMesto++;
-            ptr++;
-        }
-    }
-
-    // Длина года рождения в символах
-    int lenGodrozh = to_string(godrozh).length();
-    out << left << setw(2) << id << " | " << familiya << string(20 - lenFamiliya, ' ') << " | "
-        << imya << string(10 - lenImya, ' ') << " | " << otchestvo << string(15 - lenOtchestvo, ' ') << " | "
-        << left << setw(12) << godrozh << " | " << adres << string(28 - lenAdres, ' ') << " | "
-        << mesto << string(15 - lenMesto, ' ') << endl;
-}
-
-// Вывод базы данных в консоль
-void print(sqlite3_stmt* stmt) {
-    // Заголовок с шириной столбцов (в символах)
-    cout << left << setw(2) << u8"ID" << " | "
-        << left << setw(25) << u8"Фамилия" << " | "
-        << left << setw(13) << u8"Имя" << " | "
-        << left << setw(23) << u8"Отчество" << " | "
-        << left << setw(12) << u8"Год рождения" << " | "
-        << left << setw(35) << u8"Адрес" << " | "
-        << left << setw(15) << u8"Место" << endl;
-    cout << u8"------------------------------------------------------------------------------------------------------------------------" << endl;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        int id = sqlite3_column_int(stmt, 0);
-        const unsigned char* familiya = sqlite3_column_text(stmt, 1);
-        const unsigned char* imya = sqlite3_column_text(stmt, 2);
-        const unsigned char* otchestvo = sqlite3_column_text(stmt, 3);
-        int godrozh = sqlite3_column_int(stmt, 4);
-        const unsigned char* adres = sqlite3_column_text(stmt, 5);
-        const unsigned char* mesto = sqlite3_column_text(stmt, 6);
-
-        // Подсчёт длины каждой строки в символах (UTF-8)
-        int lenFamiliya = 0;
-        if (familiya) {
-            const unsigned char* ptr = familiya;
-            while (*ptr) {
-                if ((*ptr & 0xC0) != 0x80) lenFamiliya++;
-                ptr++;
-            }
-        }
-
-        int lenImya = 0;
-        if (imya) {
-            const unsigned char* ptr = imya;
-            while (*ptr) {
-                if ((*ptr & 0xC0) != 0x80) lenImya++;
-                ptr++;
-            }
-        }
-
-        int lenOtchestvo = 0;
-        if (otchestvo) {
-            const unsigned char* ptr = otchestvo;
-            while (*ptr) {
-                if ((*ptr & 0xC0) != 0x80) lenOtchestvo++;
-                ptr++;
-            }
-        }
-
-        int lenAdres = 0;
-        if (adres) {
-            const unsigned char* ptr = adres;
-            while (*ptr) {
-                if ((*ptr & 0xC0) != 0x80) lenAdres++;
-                ptr++;
-            }
-        }
-
-        int lenMesto = 0;
-        if (mesto) {
-            const unsigned char* ptr = mesto;
-            while (*ptr) {
-                if ((*ptr & 0xC0) != 0x80) lenMesto++;
-                ptr++;
-            }
-        }
-
-        // Длина года рождения в символах
-        int lenGodrozh = to_string(godrozh).length();
-
-        // Вывод с учётом ширины столбцов
-        cout << left << setw(2) << id << " | "
-            << (familiya ? reinterpret_cast<const char*>(familiya) : "") << string(18 - lenFamiliya, ' ') << " | "
-            << (imya ? reinterpret_cast<const char*>(imya) : "") << string(10 - lenImya, ' ') << " | "
-            << (otchestvo ? reinterpret_cast<const char*>(otchestvo) : "") << string(15 - lenOtchestvo, ' ') << " | "
-            << godrozh << string(12 - lenGodrozh, ' ') << " | "
-            << (adres ? reinterpret_cast<const char*>(adres) : "") << string(30 - lenAdres, ' ') << " | "
-            << (mesto ? reinterpret_cast<const char*>(mesto) : "") << string(15 - lenMesto, ' ') << endl;
-    }
-}
-
-// Запись результата запроса в файл
-void write(const string& f_name, sqlite3_stmt* stmt, bool append) {
-    ofstream file(f_name, append ? ios::app : ios::out);
-    if (!file) {
-        cerr << u8"Не удалось открыть файл: " << f_name << endl;
-        return;
-    }
-    if (!append) printTableHeader(file);
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        string familiya = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        string imya = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        string otchestvo = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        string adres = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        string mesto = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-        printRow(file, sqlite3_column_int(stmt, 0), familiya, imya, otchestvo,
-            sqlite3_column_int(stmt, 4), adres, mesto);
-    }
-    cout << u8"\nРезультат сохранен в файл: " << f_name;
-}
-
-// Запись одного пользователя в файл
-void writeUserToFile(const string& f_name, int id, const string& familiya, const string& imya,
-    const string& otchestvo, int godrozh, const string& adres, const string& mesto, bool append) {
-    ofstream file(f_name, append ? ios::app : ios::out);
-    if (!file) {
-        cerr << u8"Не удалось открыть файл: " << f_name << endl;
-        return;
-    }
-    if (!append) printTableHeader(file);
-    printRow(file, id, familiya, imya, otchestvo, godrozh, adres, mesto);
-}
-
-// Запрос имени файла для записи с проверкой
-void saveToFile(const string& default_name, sqlite3_stmt* stmt, bool append) {
-    int v = getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Использовать имя файла по умолчанию\n\n2) Задать собственное имя файла для записи\n-------------------------------------------------\nВведите цифру подпункта меню: ");
-    string filename, temp;
-    if (v == 1) {
-        filename = default_name;
-    }
-    else if (v == 2) {
-        do {
-            cout << u8"Введите название файла для записи данных: ";
-            cin.ignore(10000, '\n');
-            getline(cin, temp);
-            if (!isValidFilename(temp)) {
-                cin.sync();
-                keybd_event(VK_RETURN, 0, 0, 0);
-                keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
-                cout << u8"Имя файла должно содержать только буквы, цифры, подчеркивание или точку!\n";
-            }
-        } while (!isValidFilename(temp));
-        filename = temp + ".txt";
-    }
-    else {
-        cout << u8"Некорректный выбор!\n";
-        return;
-    }
-    
-    if (default_name == "year_sort.txt") {
-        last_search.last_year_file = filename;
-    }
-    else if (default_name == "adres_sort.txt") {
-        last_search.last_street_file = filename;
-    }
-    else if (default_name == "city_sort.txt") {
-        last_search.last_city_file = filename;
-    }
-    write(filename, stmt, append);
-}
-
-// Удаление пользователя по ID из базы данных и связанных файлов
-void deleteUserById(sqlite3* db, int id) {
-    // Получаем данные пользователя перед удалением
-    SQLiteStmt select_stmt(db, "SELECT familiya, imya, otchestvo, godrozh, adres, mesto FROM users WHERE id = ?;");
-    sqlite3_bind_int(select_stmt.get(), 1, id);
-
-    string familiya, imya, otchestvo, adres, mesto;
-    int godrozh = -1;
-    bool user_exists = false;
-
-    if (sqlite3_step(select_stmt.get()) == SQLITE_ROW) {
-        familiya = reinterpret_cast<const char*>(sqlite3_column_text(select_stmt.get(), 0));
-        imya = reinterpret_cast<const char*>(sqlite3_column_text(select_stmt.get(), 1));
-        otchestvo = reinterpret_cast<const char*>(sqlite3_column_text(select_stmt.get(), 2));
-        godrozh = sqlite3_column_int(select_stmt.get(), 3);
-        adres = reinterpret_cast<const char*>(sqlite3_column_text(select_stmt.get(), 4));
-        mesto = reinterpret_cast<const char*>(sqlite3_column_text(select_stmt.get(), 5));
-        user_exists = true;
-    }
-
-    // Удаляем из базы данных
-    SQLiteStmt delete_stmt(db, "DELETE FROM users WHERE id = ?;");
-    sqlite3_bind_int(delete_stmt.get(), 1, id);
-    if (sqlite3_step(delete_stmt.get()) != SQLITE_DONE) {
-        cerr << u8"Ошибка удаления из базы данных: " << sqlite3_errmsg(db) << endl;
-        return;
-    }
-
-    if (!user_exists) {
-        cout << u8"Пользователь с ID " << id << u8" не найден в базе данных." << endl;
-        return;
-    }
-
-    cout << u8"Данные успешно удалены из базы данных." << endl;
-
-    // Удаляем из файлов поиска, если они существуют
-    vector<pair<string, string>> search_files = {
-        {last_search.last_year_file.empty() ? "year_sort.txt" : last_search.last_year_file, to_string(godrozh)},
-        {last_search.last_street_file.empty() ? "adres_sort.txt" : last_search.last_street_file, adres},
-        {last_search.last_city_file.empty() ? "city_sort.txt" : last_search.last_city_file, mesto}
-    };
-
-    for (int i = 0; i < search_files.size(); ++i) {
-        string filename = search_files[i].first; 
-        string key = search_files[i].second;     
-
-        ifstream in_file(filename);
-        if (!in_file) {
-            continue; 
-        }
-
-        vector<string> lines;
-        string line;
-        bool header_written = false;
-
-        // Читаем файл построчно и сохраняем все строки, кроме той, что соответствует удаляемому ID
-        while (getline(in_file, line)) {
-            if (line.empty() || line.find("ID") != string::npos || line.find("---") != string::npos) {
-                lines.push_back(line); // Сохраняем заголовок или разделитель
-                header_written = (line.find("ID") != string::npos);
-                continue;
-            }
-
-            try {
-                stringstream ss(line);
-                string token;
-                getline(ss, token, '|');
-                int current_id = stoi(token);
-
-                if (current_id != id) {
-                    lines.push_back(line); // Сохраняем строку, если ID не совпадает
-                }
-            }
-            catch (const exception& e) {
-                cerr << u8"Ошибка парсинга строки в файле " << filename << ": " << e.what() << endl;
-                lines.push_back(line); // Сохраняем строку как есть в случае ошибки
-            }
-        }
-        in_file.close();
-
-        // Перезаписываем файл без удаленного пользователя
-        ofstream out_file(filename, ios::trunc);
-        if (!out_file) {
-            cerr << u8"Не удалось открыть файл для записи: " << filename << endl;
-            continue;
-        }
-
-        for (const auto& l : lines) {
-            out_file << l << endl;
-        }
-        out_file.close();
-    }
-}
-
-// Структура для хранения данных пользователя при сортировке
-struct User {
-    int id;
-    string familiya, imya, otchestvo;
-    int godrozh;
-    string adres, mesto;
-};
-
-// Функция сравнения для сортировки
-bool compareByField(const User& a, const User& b, int field, bool ascending) {
-    switch (field) {
-    case 0: return ascending ? a.familiya < b.familiya : a.familiya > b.familiya;
-    case 1: return ascending ? a.imya < b.imya : a.imya > b.imya;
-    case 2: return ascending ? a.otchestvo < b.otchestvo : a.otchestvo > b.otchestvo;
-    case 3: return ascending ? a.godrozh < b.godrozh : a.godrozh > b.godrozh;
-    case 4: return ascending ? a.adres < b.adres : a.adres > b.adres;
-    case 5: return ascending ? a.mesto < b.mesto : a.mesto > b.mesto;
-    default: return false;
-    }
-}
-
-// Функция очистки строки от пробелов
-string trim(const string& str) {
-    int first = str.find_first_not_of(' ');
-    if (first == string::npos) return ""; // Если строка состоит только из пробелов
-    int last = str.find_last_not_of(' ');
-    return str.substr(first, last - first + 1);
-}
-
-// Сортировка базы данных или файла
-void sort_smth(const string& table_name) {
-    SQLiteDB db(table_name);
-    int db_or_txt = getMenuChoice(u8"\nВыберите параметр для сортировки: \n-------------------------------------------------\n1) Отсортировать базу данных\n\n2) Отсортировать файл по названию\n-------------------------------------------------\nВведите цифру подпункта меню: ");
-
-    if (db_or_txt == 1) {
-        int field = getMenuChoice(u8"\nВыберите параметр для сортировки: \n-------------------------------------------------\n1) Фамилия\n\n2) Имя\n\n3) Отчество\n\n4) Год рождения\n\n5) Домашний адрес\n\n6) Место рождения\n-------------------------------------------------\nВыберете подпункт меню: ");
-        if (field < 1 || field > 6) {
-            cout << u8"Некорректный выбор!" << endl;
-            return;
-        }
-        int order = getMenuChoice(u8"\nВыберите тип сортировки для дальнейшей работы: \n-------------------------------------------------\n1) По возрастанию\n\n2) По убыванию\n-------------------------------------------------\nВведите цифру подпункта меню: ");
-        if (order != 1 && order != 2) {
-            cout << u8"Некорректный выбор!" << endl;
-            return;
-        }
-        string column[] = { "familiya", "imya", "otchestvo", "godrozh", "adres", "mesto" };
-        string ord = (order == 1) ? "ASC" : "DESC";
-        SQLiteStmt stmt(db.get(), "SELECT * FROM users ORDER BY " + column[field - 1] + " " + ord + ";");
-        print(stmt.get());
-        if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Записать отсортированную базу данных в файл\n\n2) Продолжить без сохранения\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 1) {
-            saveToFile("sorted_" + column[field - 1] + ".txt", stmt.get(), false);
-        }
-    }
-    else if (db_or_txt == 2) {
-        string filename;
-        do {
-            cout << u8"Введите имя файла для сортировки: ";
-            cin.ignore(10000, '\n');
-            getline(cin, filename);
-            if (!isValidFilename(filename)) {
-                cin.sync();
-                keybd_event(VK_RETURN, 0, 0, 0);
-                keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
-                cout << u8"Имя файла должно содержать только буквы, цифры, подчеркивание или точку!\n";
-            }
-        } while (!isValidFilename(filename));
-        filename += ".txt";
-        ifstream file(filename);
-        if (!file) {
-            cout << u8"Ошибка открытия файла: " << filename << endl;
-            return;
-        }
-
-        vector<User> users;
-        string line;
-        while (getline(file, line)) {
-            if (line.empty() || line.find("ID") != string::npos || line.find("---") != string::npos) continue;
-            User u;
-            try {
-                stringstream ss(line);
-                string token;
-                getline(ss, token, '|'); u.id = stoi(token);
-                getline(ss, token, '|'); u.familiya = trim(token);
-                getline(ss, token, '|'); u.imya = trim(token);
-                getline(ss, token, '|'); u.otchestvo = trim(token);
-                getline(ss, token, '|'); u.godrozh = stoi(token);
-                getline(ss, token, '|'); u.adres = trim(token);
-                getline(ss, token, '|'); u.mesto = trim(token);
-                users.push_back(u);
-            }
-            catch (const exception& e) {
-                cerr << u8"Ошибка парсинга строки: " << line << endl;
-                continue;
-            }
-        }
-        file.close();
-
-        if (users.empty()) {
-            cout << u8"Файл пуст или содержит некорректные данные!" << endl;
-            return;
-        }
-
-        int field = getMenuChoice(u8"\nВыберите параметр для сортировки: \n-------------------------------------------------\n1) Фамилия\n\n2) Имя\n\n3) Отчество\n\n4) Год рождения\n\n5) Домашний адрес\n\n6) Место рождения\n-------------------------------------------------\nВведите цифру подпункта меню: ");
-        if (field < 1 || field > 6) {
-            cout << u8"Некорректный выбор!" << endl;
-            return;
-        }
-        int order = getMenuChoice(u8"\nВыберите тип сортировки: \n-------------------------------------------------\n1) По возрастанию\n\n2) По убыванию\n-------------------------------------------------\nВведите цифру подпункта меню: ");
-        if (order != 1 && order != 2) {
-            cout << u8"Некорректный выбор!" << endl;
-            return;
-        }
-        sort(users.begin(), users.end(), [field, order](const User& a, const User& b) {
-            return compareByField(a, b, field - 1, order == 1);
-            });
-
-        cout << u8"\nОтсортированные данные:" << endl;
-        cout << left << setw(2) << u8"ID" << " | " << left << setw(19) << u8"Фамилия" << " | "
-            << left << setw(13) << u8"Имя" << " | " << left << setw(23) << u8"Отчество" << " | "
-            << left << setw(10) << u8"Год рождения" << " | " << left << setw(40) << u8"Адрес" << " | "
-            << left << setw(15) << u8"Место" << endl;
-        cout << u8"------------------------------------------------------------------------------------------------------------------------" << endl;
-
-        for (const auto& u : users) {
-            
-            int lenFamiliya = 0;
-            if (u.familiya != "") {
-                const unsigned char* ptr = reinterpret_cast<const unsigned char*>(u.familiya.c_str());
-                while (*ptr) {
-                    if ((*ptr & 0xC0) != 0x80) lenFamiliya++;
-                    ptr++;
-                }
-            }
-
-            int lenImya = 0;
-            if (u.imya != "") {
-                const unsigned char* ptr = reinterpret_cast<const unsigned char*>(u.imya.c_str());
-                while (*ptr) {
-                    if ((*ptr & 0xC0) != 0x80) lenImya++;
-                    ptr++;
-                }
-            }
-
-            int lenOtchestvo = 0;
-            if (u.otchestvo != "") {
-                const unsigned char* ptr = reinterpret_cast<const unsigned char*>(u.otchestvo.c_str());
-                while (*ptr) {
-                    if ((*ptr & 0xC0) != 0x80) lenOtchestvo++;
-                    ptr++;
-                }
-            }
-
-            int lenAdres = 0;
-            if (u.adres != "") {
-                const unsigned char* ptr = reinterpret_cast<const unsigned char*>(u.adres.c_str());
-                while (*ptr) {
-                    if ((*ptr & 0xC0) != 0x80) lenAdres++;
-                    ptr++;
-                }
-            }
-
-            int lenMesto = 0;
-            if (u.mesto != "") {
-                const unsigned char* ptr = reinterpret_cast<const unsigned char*>(u.mesto.c_str());
-                while (*ptr) {
-                    if ((*ptr & 0xC0) != 0x80) lenMesto++;
-                    ptr++;
-                }
-            }
-
-            // Длина года рождения в символах
-            int lenGodrozh = to_string(u.godrozh).length();
-
-            // Вывод с учётом ширины столбцов
-            cout << left << setw(2) << u.id << " | "
-                << (u.familiya.empty() ? "" : u.familiya) << string(12 - lenFamiliya, ' ') << " | "
-                << (u.imya.empty() ? "" : u.imya) << string(10 - lenImya, ' ') << " | "
-                << (u.otchestvo.empty() ? "" : u.otchestvo) << string(15 - lenOtchestvo, ' ') << " | "
-                << u.godrozh << string(12 - lenGodrozh, ' ') << " | "
-                << (u.adres.empty() ? "" : u.adres) << string(35 - lenAdres, ' ') << " | "
-                << (u.mesto.empty() ? "" : u.mesto) << string(15 - lenMesto, ' ') << endl;
-        }
-
-        if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Записать отсортированные данные в файл\n\n2) Продолжить без сохранения\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 1) {
-            string out_file, temp;
-            do {
-                cout << u8"Введите имя файла для сохранения: ";
-                cin.ignore(10000, '\n');
-                getline(cin, out_file);
-                if (!isValidFilename(out_file)) {
-                    cin.sync();
-                    keybd_event(VK_RETURN, 0, 0, 0);
-                    keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
-                    cout << u8"мя файла должно содержать только буквы, цифры, подчеркивание или точку!\n";
-                }
-            } while (!isValidFilename(out_file));
-            out_file += ".txt";
-            ofstream outfile(out_file);
-            if (!outfile) {
-                cout << u8"Ошибка создания файла: " << out_file << endl;
-                return;
-            }
-            printTableHeader(outfile);
-            for (const auto& u : users) {
-                printRow(outfile, u.id, u.familiya, u.imya, u.otchestvo, u.godrozh, u.adres, u.mesto);
-            }
-            cout << u8"Данные успешно сохранены в файл " << out_file << endl;
-        }
-    }
-    else {
-        cout << u8"Некорректный выбор!\n";
-    }
-}
-
-// Обработка операций с базой данных
-void work_db(int c, const string& table_name) {
-    SQLiteDB db(table_name);
-    string query, param, default_file;
-    bool use_int = false;
-
-    switch (c) {
-    case 1:
-        query = "SELECT * FROM users;";
-        default_file = "all_users.txt";
-        break;
-    case 2:
-        do {
-            cout << u8"Введите название улицы: ";
-            cin.ignore(10000, '\n');
-            getline(cin, param);
-            if (param.empty()) {
-                cout << u8"Название улицы не может быть пустым!\n";
-            }
-        } while (param.empty());
-        query = "SELECT * FROM users WHERE adres LIKE ?;";
-        param = "%" + param + "%";
-        default_file = "adres_sort.txt";
-        last_search.street = param.substr(1, param.length() - 2);
-        break;
-    case 3:
-        do {
-            cout << u8"Введите год рождения: ";
-            cin >> param;
-            if (!isDigitsOnly(param) || param.length() != 4 ||
-                (stoi(param) < 1900 || stoi(param) > 2025)) {
-                cout << u8"Год рождения должен быть четырехзначным числом от 1900 до 2025!\n";
-            }
-        } while (!isDigitsOnly(param) || param.length() != 4 ||
-            (stoi(param) < 1900 || stoi(param) > 2025));
-        query = "SELECT * FROM users WHERE godrozh = ?;";
-        default_file = "year_sort.txt";
-        use_int = true;
-        last_search.year = stoi(param);
-        break;
-    case 4:
-        do {
-            cout << u8"Введите город рождения: ";
-            cin.ignore(10000, '\n');
-            getline(cin, param);
-            if (!isRussianLettersOnly(param)) {
-                cout << u8"Город рождения должен содержать только буквы!\n";
-            }
-        } while (!isRussianLettersOnly(param));
-        query = "SELECT * FROM users WHERE mesto = ?;";
-        default_file = "city_sort.txt";
-        last_search.city = param;
-        break;
-    case 5:
-        sort_smth(table_name);
-        return;
-    case 7: {
-        SQLiteStmt stmt(db.get(), "SELECT * FROM users;");
-        print(stmt.get());
-        string id_str;
-        int id;
-        do {
-            cout << u8"\nВведите ID пользователя для удаления: ";
-            cin >> id_str;
-            if (!isDigitsOnly(id_str) || stoi(id_str) <= 0) {
-                cout << u8"ID должен быть положительным числом!\n";
-            }
-        } while (!isDigitsOnly(id_str) || stoi(id_str) <= 0);
-        id = stoi(id_str);
-        deleteUserById(db.get(), id);
-        return;
-    }
-    case 8: {
-        string filename;
-        do {
-            cout << u8"Введите имя файла для вывода в консоль: ";
-            cin.ignore(10000, '\n');
-            getline(cin, filename);
-            if (!isValidFilename(filename)) {
-                cin.sync();
-                keybd_event(VK_RETURN, 0, 0, 0);
-                keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
-                cout << u8"Имя файла должно содержать только буквы, цифры, подчеркивание или точку!\n";
-            }
-        } while (!isValidFilename(filename));
-        filename += ".txt";
-        ifstream file(filename);
-        if (!file) {
-            cout << u8"Ошибка открытия файла: " << filename << endl;
-            return;
-        }
-
-        vector<User> users;
-        string line;
-        while (getline(file, line)) {
-            if (line.empty() || line.find("ID") != string::npos || line.find("---") != string::npos) continue;
-            User u;
-            try {
-                stringstream ss(line);
-                string token;
-                getline(ss, token, '|'); u.id = stoi(token);
-                getline(ss, token, '|'); u.familiya = trim(token);
-                getline(ss, token, '|'); u.imya = trim(token);
-                getline(ss, token, '|'); u.otchestvo = trim(token);
-                getline(ss, token, '|'); u.godrozh = stoi(token);
-                getline(ss, token, '|'); u.adres = trim(token);
-                getline(ss, token, '|'); u.mesto = trim(token);
-                users.push_back(u);
-            }
-            catch (const exception& e) {
-                cerr << u8"Ошибка парсинга строки: " << line << endl;
-                continue;
-            }
-        }
-        file.close();
-
-        if (users.empty()) {
-            cout << u8"Файл пуст или содержит некорректные данные!" << endl;
-            return;
-        }
-
-        cout << u8"\nДанные из файла:" << endl;
-        cout << left << setw(2) << u8"ID" << " | " << left << setw(27) << u8"Фамилия" << " | "
-            << left << setw(13) << u8"Имя" << " | " << left << setw(23) << u8"Отчество" << " | "
-            << left << setw(10) << u8"Год рождения" << " | " << left << setw(33) << u8"Адрес" << " | "
-            << left << setw(15) << u8"Место" << endl;
-        cout << u8"------------------------------------------------------------------------------------------------------------------------" << endl;
-
-
-        for (const auto& u : users) {
-
-            int lenFamiliya = 0;
-            if (u.familiya != "") {
-                const unsigned char* ptr = reinterpret_cast<const unsigned char*>(u.familiya.c_str());
-                while (*ptr) {
-                    if ((*ptr & 0xC0) != 0x80) lenFamiliya++;
-                    ptr++;
-                }
-            }
-
-            int lenImya = 0;
-            if (u.imya != "") {
-                const unsigned char* ptr = reinterpret_cast<const unsigned char*>(u.imya.c_str());
-                while (*ptr) {
-                    if ((*ptr & 0xC0) != 0x80) lenImya++;
-                    ptr++;
-                }
-            }
-
-            int lenOtchestvo = 0;
-            if (u.otchestvo != "") {
-                const unsigned char* ptr = reinterpret_cast<const unsigned char*>(u.otchestvo.c_str());
-                while (*ptr) {
-                    if ((*ptr & 0xC0) != 0x80) lenOtchestvo++;
-                    ptr++;
-                }
-            }
-
-            int lenAdres = 0;
-            if (u.adres != "") {
-                const unsigned char* ptr = reinterpret_cast<const unsigned char*>(u.adres.c_str());
-                while (*ptr) {
-                    if ((*ptr & 0xC0) != 0x80) lenAdres++;
-                    ptr++;
-                }
-            }
-
-            int lenMesto = 0;
-            if (u.mesto != "") {
-                const unsigned char* ptr = reinterpret_cast<const unsigned char*>(u.mesto.c_str());
-                while (*ptr) {
-                    if ((*ptr & 0xC0) != 0x80) lenMesto++;
-                    ptr++;
-                }
-            }
-
-            // Длина года рождения в символах
-            int lenGodrozh = to_string(u.godrozh).length();
-
-            // Вывод с учётом ширины столбцов
-            cout << left << setw(2) << u.id << " | "
-                << (u.familiya.empty() ? "" : u.familiya) << string(20 - lenFamiliya, ' ') << " | "
-                << (u.imya.empty() ? "" : u.imya) << string(10 - lenImya, ' ') << " | "
-                << (u.otchestvo.empty() ? "" : u.otchestvo) << string(15 - lenOtchestvo, ' ') << " | "
-                << u.godrozh << string(12 - lenGodrozh, ' ') << " | "
-                << (u.adres.empty() ? "" : u.adres) << string(28 - lenAdres, ' ') << " | "
-                << (u.mesto.empty() ? "" : u.mesto) << string(15 - lenMesto, ' ') << endl;
-        }
-        return;
-    }
-    default:
-        cout << u8"Неверный выбор." << endl;
-        return;
-    }
-
-    SQLiteStmt stmt(db.get(), query);
-
-    if (c == 2 || c == 4) {
-        sqlite3_bind_text(stmt.get(), 1, param.c_str(), -1, SQLITE_STATIC);
-        if (sqlite3_step(stmt.get()) != SQLITE_ROW) {
-            cout << u8"\nНе найдены данные, удовлетворяющие введенному критерию!";
-            return;
-        }
-    }
-    else if (c == 3) {
-        sqlite3_bind_int(stmt.get(), 1, stoi(param));
-    }
-    print(stmt.get()); 
-
-    if (c != 1) {
-        if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Записать базу данных по найденному параметру в файл\n\n2) Продолжить работу с базой данных без сохранения\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 1) {
-            SQLiteStmt new_stmt(db.get(), query);
-            if (c == 2 || c == 4) {
-                sqlite3_bind_text(new_stmt.get(), 1, param.c_str(), -1, SQLITE_STATIC);
-            }
-            else if (c == 3) {
-                sqlite3_bind_int(new_stmt.get(), 1, stoi(param));
-            }
-            saveToFile(default_file, new_stmt.get(), false);
-        }
-    }
-}
-
-// Создание или дополнение базы данных
-void create_db(const string& name, bool append) {
-    SQLiteDB db(name);
-    const char* createTableSQL = "CREATE TABLE IF NOT EXISTS users ("
-        "id INTEGER PRIMARY KEY AUTOINCREMENT, familiya TEXT NOT NULL, "
-        "imya TEXT NOT NULL, otchestvo TEXT NOT NULL, godrozh INTEGER NOT NULL, "
-        "adres TEXT NOT NULL, mesto TEXT NOT NULL);";
-    if (sqlite3_exec(db.get(), createTableSQL, nullptr, nullptr, nullptr) != SQLITE_OK) {
-        cerr << u8"Ошибка создания таблицы: " << sqlite3_errmsg(db.get()) << endl;
-        return;
-    }
-
-    int count = getMenuChoice(u8"Укажите кол-во вводимых избирателей: ");
-    for (int i = 0; i < count; ++i) {
-        string familiya, imya, otchestvo, prev_adres, mesto, godrozh_str, adres = "";
-        int godrozh;
-
-        // Ввод фамилии
-        do {
-            cin.clear();
-            cin.ignore(1000, '\n');
-            cout << u8"Введите фамилию: ";
-            getline(cin, familiya); 
-            if (!isCorrectSecondname(familiya) or !firstTrue(familiya)) {
-                cout << u8"Фамилия должна содержать только русские буквы или дефис и начинаться с заглавной буквы!";
-                cin.sync();
-                keybd_event(VK_RETURN, 0, 0, 0);
-                keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
-            }
-            else {
-                keybd_event(VK_RETURN, 0, 0, 0);
-                keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
-                break;
-            }
-        } while (true);
-
-        // Ввод имени
-        do {
-            cin.clear();
-            cin.ignore(1000, '\n');
-            cout << u8"Введите имя: ";
-            getline(cin, imya);
-            if (!isRussianLettersOnly(imya) or !firstTrue(imya)) {
-                cout << u8"Имя должно содержать только русские буквы и начинаться с заглавной буквы!";
-                cin.sync();
-                keybd_event(VK_RETURN, 0, 0, 0);
-                keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
-            }
-            else {
-                keybd_event(VK_RETURN, 0, 0, 0);
-                keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
-                break;
-            }
-        } while (true);
-
-        // Ввод отчества
-        do {
-            cin.clear();
-            cin.ignore(1000, '\n');
-            cout << u8"Введите отчество: ";
-            getline(cin, otchestvo);
-            if (!isRussianLettersOnly(otchestvo) or !firstTrue(otchestvo)) {
-                cout << u8"Отчество должно содержать только русские буквы и начинаться с заглавной буквы!";
-                cin.sync();
-                keybd_event(VK_RETURN, 0, 0, 0);
-                keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
-            }
-            else {
-                keybd_event(VK_RETURN, 0, 0, 0);
-                keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
-                cin.ignore(100, '\n');
-                break;
-            }
-        } while (true);
-
-        // Ввод года рождения
-        do {
-            cout << u8"Введите год рождения: ";
-            cin.clear();
-            getline(cin, godrozh_str);
-            try {
-                godrozh = stoi(godrozh_str);
-                if (godrozh < 1930 || godrozh > 2007) {
-                    cout << u8"Год рождения должен быть от 1930 до 2007!\n";
-                    continue;
-                }
-                break;
-            }
-            catch (const exception& e) {
-                cout << u8"Введите корректное число!\n";
-            }
-        } while (true);
-        cout << endl;
-        // Ввод адреса
-        do {
-            locale loc("ru_RU.UTF-8");
-            cout << u8"Введите название улицы, номер дома и номер квартиры через пробел(пример: Ленина 64 5): ";
-            cin.clear();
-            cin.sync();
-            getline(cin, prev_adres);
-            if (!(firstTrue(prev_adres))) {
-                cout << u8"Неверный формат адреса! Проверьте заглавную букву в названии улицы " << endl;
-            }
-            else {
-                string ulitsa;
-                int dom = 0, kv = 0;
-                istringstream iss(prev_adres);
-                iss >> ulitsa >> dom >> kv;
-                if (!(kv == 0) or !(dom == 0)) {
-                    keybd_event(VK_RETURN, 0, 0, 0);
-                    keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
-                    adres = u8"Ул. " + ulitsa + u8", д. " + to_string(dom) + u8", кв. " + to_string(kv);
-                    break;
-                }
-                else {
-                    cout << u8"Неверный формат адреса! Введите заново в формате улица, номер дома и номер квартиры" << endl;
-                }
-            }
-        } while (true);
-
-        // Ввод места рождения
-        do {
-            cin.clear();
-            cin.ignore(1000, '\n');
-            cout << u8"Введите место рождения: ";
-            getline(cin, mesto);
-            if (!isRussianLettersOnly(mesto) or !firstTrue(mesto)) {
-                cout << u8"Место рождения должно содержать только русские буквы или пробел и начинаться с заглавной буквы!";
-                cin.sync();
-                keybd_event(VK_RETURN, 0, 0, 0);
-                keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
-            }
-            else {
-                keybd_event(VK_RETURN, 0, 0, 0);
-                keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
-                break;
-            }
-        } while (true);
-
-        SQLiteStmt stmt(db.get(), "INSERT INTO users (familiya, imya, otchestvo, godrozh, adres, mesto) VALUES (?, ?, ?, ?, ?, ?);");
-        sqlite3_bind_text(stmt.get(), 1, familiya.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt.get(), 2, imya.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt.get(), 3, otchestvo.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_int(stmt.get(), 4, godrozh);
-        sqlite3_bind_text(stmt.get(), 5, adres.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt.get(), 6, mesto.c_str(), -1, SQLITE_STATIC);
-        if (sqlite3_step(stmt.get()) != SQLITE_DONE) {
-            cerr << u8"Ошибка добавления данных: " << sqlite3_errmsg(db.get()) << endl;
-            continue;
-        }
-        cout << u8"Данные успешно добавлены в базу данных." << endl;
-
-        int new_id = static_cast<int>(sqlite3_last_insert_rowid(db.get()));
-
-        // Добавление в файл для года
-        if (last_search.year != -1 && godrozh == last_search.year) {
-            string target_file = last_search.last_year_file.empty() ? "year_sort.txt" : last_search.last_year_file;
-            writeUserToFile(target_file, new_id, familiya, imya, otchestvo, godrozh, adres, mesto, true);
-           
-        }
-        // Добавление в файл для улицы
-        if (!last_search.street.empty() && adres.find(last_search.street) != string::npos) {
-            string target_file = last_search.last_street_file.empty() ? "adres_sort.txt" : last_search.last_street_file;
-            writeUserToFile(target_file, new_id, familiya, imya, otchestvo, godrozh, adres, mesto, true);
-            
-        }
-        // Добавление в файл для города
-        if (!last_search.city.empty() && mesto == last_search.city) {
-            string target_file = last_search.last_city_file.empty() ? "city_sort.txt" : last_search.last_city_file;
-            writeUserToFile(target_file, new_id, familiya, imya, otchestvo, godrozh, adres, mesto, true);
-            
-        }
-
-        string sort_files[] = { "sorted_familiya.txt", "sorted_imya.txt", "sorted_otchestvo.txt",
-                               "sorted_godrozh.txt", "sorted_adres.txt", "sorted_mesto.txt" };
-        for (const auto& file : sort_files) {
-            ifstream check(file);
-            if (check.good()) {
-                writeUserToFile(file, new_id, familiya, imya, otchestvo, godrozh, adres, mesto, true);
-            }
-            check.close();
-        }
-
-        if (append && last_search.year == -1 && last_search.city.empty() && last_search.street.empty()) {
-            SQLiteStmt stmt_addr(db.get(), "SELECT * FROM users WHERE adres LIKE ?;");
-            sqlite3_bind_text(stmt_addr.get(), 1, ("%" + adres + "%").c_str(), -1, SQLITE_STATIC);
-            write("adres_sort.txt", stmt_addr.get(), true);
-
-            SQLiteStmt stmt_year(db.get(), "SELECT * FROM users WHERE godrozh = ?;");
-            sqlite3_bind_int(stmt_year.get(), 1, godrozh);
-            write("year_sort.txt", stmt_year.get(), true);
-
-            SQLiteStmt stmt_city(db.get(), "SELECT * FROM users WHERE mesto = ?;");
-            sqlite3_bind_text(stmt_city.get(), 1, mesto.c_str(), -1, SQLITE_STATIC);
-            write("city_sort.txt", stmt_city.get(), true);
-        }
-    }
-}
-
-// Работа с существующей базой данных
-void later_db(const string& table_name) {
-    if (table_name == "list_voiters1.db") {
-        cout << u8"\n\n\t\t\t\tВыбрана функция работы с предустановленной базой данных" << endl;
-    }
-    else {
-        cout << u8"\n\n\t\t\tВыбрана функция работы с созданной базой данных" << endl;
-    }
-    while (true) {
-        int choice = getMenuChoice(u8"\n\n\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Вывести базу данных в консоль\n\n2) Найти по улице, на которой проживает избиратель\n\n3) Найти по году рождения избирателя\n\n4) Найти по городу рождения избирателя\n\n5) Отсортировать базу данных или файл\n\n6) Дополнить базу данных\n\n7) Удалить пользователя по ID\n\n8) Вывести содержимое файла из директории\n\n9) Назад\n-------------------------------------------------\nВведите цифру подпункта меню: ");
-        if (choice == 9) {
-            cout << "\n\n";
-            return;
-        }
-        if (choice == 6) create_db(table_name, true);
-        else work_db(choice, table_name);
-    }
-}
-
-// Главная функция программы
-int main() {
-    setlocale(LC_ALL, "ru_RU.UTF-8");
-    SetConsoleCP(CP_UTF8);
-    SetConsoleOutputCP(CP_UTF8);
-#ifdef _WIN32
-    system("chcp 65001 > nul");
-#endif
-    cout << u8"\t\t\t\tОзнакомительная практика Рыжов Степан УИБ-111 :)\n" << endl;
-    while (true) {
-        int choice = getMenuChoice(u8"\t\t\t\t\t\tГлавное меню\n\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Использовать существующую базу данных\n\n2) Создать новую базу данных\n\n3) Выход из программы\n-------------------------------------------------\nВведите цифру подпункта меню: ");
-        string db_name;
-        switch (choice) {
-        case 1:
-            do {
-                cout << u8"Введите имя базы данных (по умолчанию вводите list_voiters1): ";
-                cin.ignore(10000, '\n');
-                cin.sync();
-                getline(cin, db_name);
-                if (!isValidFilename(db_name)) {
-                    cin.sync();
-                    keybd_event(VK_RETURN, 0, 0, 0);
-                    keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
-                    cout << u8"Имя базы данных должно содержать только буквы, цифры, подчеркивание или точку!\n";
-                }
-            } while (!isValidFilename(db_name));
-            later_db(db_name + ".db");
-            break;
-        case 2:
-            do {
-                cin.clear();
-                cin.ignore(1000, '\n');
-                cout << u8"Введите имя базы данных для создания: ";
-                getline(cin, db_name);
-                if (!isValidFilename(db_name)) {
-                    cout << u8"Имя базы данных должно содержать только буквы, цифры, подчеркивание или точку!";
-                    cin.sync();
-                    keybd_event(VK_RETURN, 0, 0, 0);
-                    keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
-                }
-                else {
-                    break;
-                }
-            } while (true);
-            create_db(db_name + ".db", false);
-            later_db(db_name + ".db");
-            break;
-        case 3:
-            return 0;
-        default:
-            cout << u8"Неверно введенная функция!\n\n";
-            break;
-        }
-    }
-    return 0;
-}
-
-/* Программа разработана студентом группы УИБ-111 Рыжовым Степаном, с использованием базы данных SQL и консольного интерфейса
-Использованные библиотеки: 
-<iostream>
-<iomanip>
-<fstream>
-<string>
-<vector>
-<algorithm>
-<sstream>
-<Windows.h>
-*/
\ No newline at end of file
+﻿#include "voters.h"
+#include "terminal.h"
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+typedef SOCKET socket_t;
+#define closeSocket closesocket
+#define SHUT_RDWR SD_BOTH
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+typedef int socket_t;
+#define INVALID_SOCKET (-1)
+#define closeSocket close
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#include <csignal>
+
+using namespace std;
+
+// Функция для получения выбора пользователя из меню с проверкой ввода
+int getMenuChoice(const string& prompt) {
+    int choice;
+    cout << prompt;
+    cin >> choice;
+    while (cin.fail() || cin.peek() != '\n') {
+        cout << u8"Некорректный выбор\nПовторите ввод: ";
+        cin.clear();
+        cin.ignore(10000, '\n');
+        cin >> choice;
+    }
+    return choice;
+}
+
+// Запрос у пользователя одного или нескольких столбцов сортировки с направлением
+bool askSortKeys(vector<SortKey>& keys) {
+    keys.clear();
+    while (keys.size() < 6) {
+        int field = getMenuChoice(keys.empty()
+            ? u8"\nВыберите параметр для сортировки: \n-------------------------------------------------\n1) Фамилия\n\n2) Имя\n\n3) Отчество\n\n4) Год рождения\n\n5) Домашний адрес\n\n6) Место рождения\n-------------------------------------------------\nВведите цифру подпункта меню: "
+            : u8"\nВыберите дополнительный параметр для сортировки: \n-------------------------------------------------\n1) Фамилия\n\n2) Имя\n\n3) Отчество\n\n4) Год рождения\n\n5) Домашний адрес\n\n6) Место рождения\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+        if (field < 1 || field > 6) {
+            cout << u8"Некорректный выбор!" << endl;
+            return false;
+        }
+        bool duplicate = false;
+        for (const auto& k : keys) {
+            if (k.field == field - 1) duplicate = true;
+        }
+        if (duplicate) {
+            cout << u8"Сортировка по этому параметру уже задана!" << endl;
+            continue;
+        }
+        int order = getMenuChoice(u8"\nВыберите тип сортировки: \n-------------------------------------------------\n1) По возрастанию\n\n2) По убыванию\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+        if (order != 1 && order != 2) {
+            cout << u8"Некорректный выбор!" << endl;
+            return false;
+        }
+        keys.push_back({ field - 1, order == 1 });
+        if (keys.size() == 6) break;
+        if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Добавить еще один параметр сортировки\n\n2) Выполнить сортировку\n-------------------------------------------------\nВведите цифру подпункта меню: ") != 1) break;
+    }
+    return true;
+}
+
+// Вывод статистики по избирателям
+void showStats(sqlite3* db) {
+    VoterStats stats = syncStats(db);
+    cout << u8"\nВсего избирателей: " << stats.total << endl;
+    cout << u8"Различных фамилий (приблизительно): " << static_cast<int64_t>(stats.distinct_familiya.estimate() + 0.5) << endl;
+    cout << u8"Различных городов рождения (приблизительно): " << static_cast<int64_t>(stats.distinct_mesto.estimate() + 0.5) << endl;
+    cout << u8"Различных улиц (приблизительно): " << static_cast<int64_t>(stats.distinct_street.estimate() + 0.5) << endl;
+    if (stats.deletes > 0) {
+        cout << u8"После последнего пересчета удалено записей: " << stats.deletes
+            << u8" - число различных значений может быть завышено" << endl;
+    }
+
+    cout << u8"\nСамые частые города рождения (приблизительно):" << endl;
+    for (const auto& c : stats.top_mesto.top(10)) {
+        cout << "  " << c.first << ": " << c.second << endl;
+    }
+    cout << u8"\nСамые частые улицы (приблизительно):" << endl;
+    for (const auto& c : stats.top_street.top(10)) {
+        cout << "  " << c.first << ": " << c.second << endl;
+    }
+
+    cout << u8"\nРаспределение по годам рождения:" << endl;
+    int64_t max_count = 1;
+    for (const auto& y : stats.years) {
+        if (y.second > max_count) max_count = y.second;
+    }
+    for (const auto& y : stats.years) {
+        cout << "  " << y.first << " | " << left << setw(10) << y.second << " | "
+            << string(static_cast<size_t>(y.second * 50 / max_count), '#') << endl;
+    }
+
+    if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Пересчитать статистику по всей базе данных\n\n2) Продолжить работу с базой данных\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 1) {
+        rebuildStats(db);
+        cout << u8"Статистика пересчитана." << endl;
+    }
+}
+
+// Фоновые выгрузки текущего сеанса работы
+vector<unique_ptr<ExportJob>> export_jobs;
+
+// Запуск фоновой выгрузки результата подготовленного запроса (с подставленными параметрами)
+void startExportJob(sqlite3_stmt* stmt, const string& filename, const string& kind, const string& param) {
+    char* sql = sqlite3_expanded_sql(stmt);
+    const char* db_name = sqlite3_db_filename(sqlite3_db_handle(stmt), "main");
+    if (!sql || !db_name) {
+        sqlite3_free(sql);
+        cerr << u8"Не удалось запустить фоновую выгрузку" << endl;
+        return;
+    }
+    int id = static_cast<int>(export_jobs.size()) + 1;
+    export_jobs.emplace_back(new ExportJob(id, db_name, sql, filename, kind, param));
+    sqlite3_free(sql);
+    cout << u8"\nВыгрузка в файл " << filename << u8" запущена в фоновом режиме (задание " << id << ")" << endl;
+}
+
+// Просмотр состояния фоновых выгрузок и их отмена
+void showExportJobs() {
+    if (export_jobs.empty()) {
+        cout << u8"\nФоновых выгрузок нет" << endl;
+        return;
+    }
+    const char* states[] = { u8"выполняется", u8"завершено", u8"отменено", u8"ошибка" };
+    cout << endl;
+    for (const auto& job : export_jobs) {
+        cout << job->id << ") " << job->filename << " - " << states[job->state] << u8", строк: " << job->rows
+            << ", " << fixed << setprecision(1) << job->bytes / 1048576.0 << u8" МБ, " << job->seconds() << u8" с" << endl;
+    }
+    cout.unsetf(ios::fixed);
+    if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Отменить выгрузку\n\n2) Продолжить работу с базой данных\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 1) {
+        int id = getMenuChoice(u8"Введите номер задания: ");
+        if (id < 1 || id > static_cast<int>(export_jobs.size()) || export_jobs[id - 1]->state != ExportJob::Running) {
+            cout << u8"Задание не найдено или уже завершено" << endl;
+            return;
+        }
+        export_jobs[id - 1]->cancel();
+        cout << u8"Выгрузка отменена" << endl;
+    }
+}
+
+// Ожидание завершения всех фоновых выгрузок (перед выходом из программы)
+void finishExportJobs() {
+    for (auto& job : export_jobs) {
+        if (job->state == ExportJob::Running) {
+            cout << u8"Ожидание завершения выгрузки в файл " << job->filename << "..." << endl;
+        }
+        job->wait();
+    }
+}
+
+// Запрос имени файла для записи с проверкой
+// Сохраненный файл регистрируется как отчет вида kind, если вид задан.
+// Строки берутся из курсора, поэтому уже выведенный на экран результат
+// не запрашивается повторно. Фоновая запись выполняет запрос заново на
+// собственном подключении и недоступна для запросов к временным таблицам.
+void saveToFile(const string& default_name, ResultCursor& rows, bool append, const string& kind, const string& param,
+    bool allow_background = true) {
+    sqlite3_stmt* stmt = rows.statement();
+    int format = FormatTable;
+    if (!append) {
+        format = getMenuChoice(u8"\nВыберите формат файла: \n-------------------------------------------------\n1) Таблица (.txt)\n\n2) CSV (.csv)\n\n3) JSON (.json)\n\n4) NDJSON - по одной записи JSON в строке (.ndjson)\n\n5) Таблица с записями фиксированной длины для поиска по ID (.tbl)\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+        if (format < FormatTable || format > FormatFixed) {
+            cout << u8"Некорректный выбор!\n";
+            return;
+        }
+    }
+    int v = getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Использовать имя файла по умолчанию\n\n2) Задать собственное имя файла для записи\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+    string filename, temp;
+    if (v == 1) {
+        filename = default_name.substr(0, default_name.rfind('.')) + formatExtension(format);
+    }
+    else if (v == 2) {
+        do {
+            cout << u8"Введите название файла для записи данных: ";
+            cin.ignore(10000, '\n');
+            getline(cin, temp);
+            if (!isValidFilename(temp)) {
+                cin.sync();
+                pressEnter();
+                cout << u8"Имя файла должно содержать только буквы, цифры, подчеркивание или точку!\n";
+            }
+        } while (!isValidFilename(temp));
+        filename = temp + formatExtension(format);
+    }
+    else {
+        cout << u8"Некорректный выбор!\n";
+        return;
+    }
+
+    // Файлы с записями фиксированной длины обновляются по журналу на месте
+    if (format == FormatFixed) {
+        long long count = writeFixedReport(filename, rows);
+        if (count < 0) return;
+        cout << u8"\nРезультат сохранен в файл: " << filename << u8" (записей: " << count << ")";
+        if (!kind.empty()) registerReport(sqlite3_db_handle(stmt), filename, kind, param, rows.position());
+        return;
+    }
+    // Файлы CSV и JSON предназначены для других систем и не обновляются по журналу
+    if (format != FormatTable) {
+        long long count = exportRows(filename, rows, format);
+        if (count >= 0) cout << u8"\nРезультат сохранен в файл: " << filename << u8" (строк: " << count << ")";
+        return;
+    }
+    // Фоновая выгрузка читает базу в одной долгой транзакции, которая в режиме
+    // журнала DELETE не дает вносить изменения до конца выгрузки
+    if (!append && allow_background && !walMode(sqlite3_db_handle(stmt))) {
+        cout << u8"\nФоновая выгрузка доступна в профилях хранения с журналом WAL, файл записывается сейчас" << endl;
+    }
+    else if (!append && allow_background && getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Записать сейчас\n\n2) Записать в фоновом режиме и продолжить работу\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 2) {
+        startExportJob(stmt, filename, kind, param);
+        return;
+    }
+    if (write(filename, rows, append) && !kind.empty()) {
+        registerReport(sqlite3_db_handle(stmt), filename, kind, param, rows.position());
+    }
+}
+
+// Сортировка базы данных или файла
+void sort_smth(const string& table_name) {
+    SQLiteDB db(table_name);
+    int db_or_txt = getMenuChoice(u8"\nВыберите параметр для сортировки: \n-------------------------------------------------\n1) Отсортировать базу данных\n\n2) Отсортировать файл по названию\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+
+    if (db_or_txt == 1) {
+        vector<SortKey> keys;
+        if (!askSortKeys(keys)) return;
+        SQLiteStmt stmt(db.get(), "SELECT * FROM users ORDER BY " + orderByClause(keys) + ";");
+        ResultCursor rows(stmt.get());
+        print(rows);
+        if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Записать отсортированную базу данных в файл\n\n2) Продолжить без сохранения\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 1) {
+            saveToFile("sorted_" + sort_columns[keys[0].field] + ".txt", rows, false, "sorted", orderByClause(keys));
+        }
+    }
+    else if (db_or_txt == 2) {
+        string filename;
+        do {
+            cout << u8"Введите имя файла для сортировки: ";
+            cin.ignore(10000, '\n');
+            getline(cin, filename);
+            if (!isValidFilename(filename)) {
+                cin.sync();
+                pressEnter();
+                cout << u8"Имя файла должно содержать только буквы, цифры, подчеркивание или точку!\n";
+            }
+        } while (!isValidFilename(filename));
+        filename += ".txt";
+        syncReports(db.get(), filename);
+        {
+            ifstream check(filename);
+            if (!check) {
+                cout << u8"Ошибка открытия файла: " << filename << endl;
+                return;
+            }
+        }
+
+        vector<SortKey> keys;
+        if (!askSortKeys(keys)) return;
+        string sorted_name = filename + ".sorted";
+        long long count = externalSortReport(filename, sorted_name, keys);
+        if (count < 0) return;
+        if (count == 0) {
+            cout << u8"Файл пуст или содержит некорректные данные!" << endl;
+            remove(sorted_name.c_str());
+            return;
+        }
+
+        cout << u8"\nОтсортированные данные:" << endl;
+        printTableHeader(cout);
+        {
+            PROFILE_SCOPE(ProfileRender);
+            ReportPipeline(sorted_name).run([](const User& u) {
+                printRow(cout, u.id, u.familiya, u.imya, u.otchestvo, u.godrozh, u.adres, u.mesto);
+                });
+        }
+
+        if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Записать отсортированные данные в файл\n\n2) Продолжить без сохранения\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 1) {
+            string out_file;
+            do {
+                cout << u8"Введите имя файла для сохранения: ";
+                cin.ignore(10000, '\n');
+                getline(cin, out_file);
+                if (!isValidFilename(out_file)) {
+                    cin.sync();
+                    pressEnter();
+                    cout << u8"Имя файла должно содержать только буквы, цифры, подчеркивание или точку!\n";
+                }
+            } while (!isValidFilename(out_file));
+            out_file += ".txt";
+            // Отсортированный файл уже записан - он атомарно заменяет целевой
+            FileBatch batch;
+            batch.add(out_file, sorted_name);
+            if (!batch.commit()) {
+                cout << u8"Ошибка создания файла: " << out_file << endl;
+                return;
+            }
+            cout << u8"Данные успешно сохранены в файл " << out_file << endl;
+            return;
+        }
+        remove(sorted_name.c_str());
+    }
+    else {
+        cout << u8"Некорректный выбор!\n";
+    }
+}
+
+// Поиск по началу фамилии или имени: подсказки из префиксного дерева
+// и выборка строк диапазонным запросом по индексу (column >= префикс AND column < следующий)
+void prefixSearch(sqlite3* db) {
+    int field = getMenuChoice(u8"\nВыберите параметр для поиска: \n-------------------------------------------------\n1) Начало фамилии\n\n2) Начало имени\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+    if (field != 1 && field != 2) {
+        cout << u8"Некорректный выбор!" << endl;
+        return;
+    }
+    string prefix;
+    do {
+        cout << u8"Введите начало " << (field == 1 ? u8"фамилии" : u8"имени") << ": ";
+        cin.ignore(10000, '\n');
+        getline(cin, prefix);
+        if (!isCorrectSecondname(prefix)) {
+            cin.sync();
+            pressEnter();
+            cout << u8"Начало должно содержать только русские буквы или дефис!\n";
+        }
+    } while (!isCorrectSecondname(prefix));
+    prefix = capitalizeFirst(prefix);
+
+    const NameTrie& trie = prefixTrie(db, field - 1);
+    auto started = chrono::steady_clock::now();
+    vector<pair<string, int64_t>> suggestions = trie.complete(prefix, 10);
+    int64_t total = trie.countPrefix(prefix);
+    auto elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - started).count();
+
+    if (total == 0) {
+        cout << u8"\nНе найдены данные, удовлетворяющие введенному критерию!";
+        return;
+    }
+    cout << u8"\nВарианты (" << elapsed << u8" мкс):" << endl;
+    for (const auto& sgn : suggestions) {
+        cout << "  " << sgn.first << " (" << sgn.second << ")" << endl;
+    }
+    cout << u8"Всего записей: " << total << endl;
+
+    string column = field == 1 ? "familiya" : "imya";
+    string upper = prefixSuccessor(prefix);
+    string query = "SELECT * FROM users WHERE " + column + " >= ?" + (upper.empty() ? "" : " AND " + column + " < ?")
+        + " ORDER BY " + column + ", id;";
+    if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Вывести найденные записи\n\n2) Продолжить работу с базой данных\n-------------------------------------------------\nВведите цифру подпункта меню: ") != 1) {
+        return;
+    }
+    SQLiteStmt stmt(db, query);
+    sqlite3_bind_text(stmt.get(), 1, prefix.c_str(), -1, SQLITE_STATIC);
+    if (!upper.empty()) sqlite3_bind_text(stmt.get(), 2, upper.c_str(), -1, SQLITE_STATIC);
+    ResultCursor rows(stmt.get());
+    print(rows);
+
+    if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Записать найденные записи в файл\n\n2) Продолжить работу с базой данных без сохранения\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 1) {
+        saveToFile("prefix_" + column + ".txt", rows, false, "prefix_" + column, prefix);
+    }
+}
+
+// Нечеткий поиск по ФИО с учетом опечаток и путаницы Е/Ё.
+// Для каждой введенной части подбираются похожие значения, а строки
+// выбираются соединением с ними и упорядочиваются по суммарному расстоянию.
+void fuzzySearch(sqlite3* db) {
+    string input;
+    vector<string> parts;
+    do {
+        parts.clear();
+        cout << u8"Введите фамилию, при необходимости имя и отчество через пробел: ";
+        cin.ignore(10000, '\n');
+        getline(cin, input);
+        stringstream ss(input);
+        string part;
+        bool valid = true;
+        while (ss >> part) {
+            if (!isCorrectSecondname(part)) valid = false;
+            parts.push_back(part);
+        }
+        if (!valid || parts.empty() || parts.size() > 3) {
+            cin.sync();
+            pressEnter();
+            cout << u8"Введите от одного до трех слов из русских букв!\n";
+            parts.clear();
+        }
+    } while (parts.empty());
+
+    const FuzzyCache& index = fuzzyIndex(db);
+    auto started = chrono::steady_clock::now();
+    vector<vector<pair<string, int>>> matches(parts.size());
+    for (size_t f = 0; f < parts.size(); ++f) {
+        matches[f] = index.fields[f].search(parts[f], 50);
+    }
+    auto elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - started).count();
+
+    const char* titles[] = { u8"Похожие фамилии", u8"Похожие имена", u8"Похожие отчества" };
+    for (size_t f = 0; f < parts.size(); ++f) {
+        if (matches[f].empty()) {
+            cout << u8"\nНе найдены данные, удовлетворяющие введенному критерию!";
+            return;
+        }
+        cout << "\n" << titles[f] << ":";
+        for (size_t i = 0; i < matches[f].size() && i < 10; ++i) {
+            cout << " " << matches[f][i].first << " (" << matches[f][i].second << ")";
+        }
+    }
+    cout << u8"\nПодбор вариантов: " << elapsed << u8" мкс" << endl;
+
+    // WITH f0(v, d) AS (VALUES (?, ?), ...) SELECT users.* FROM users JOIN f0 ON users.familiya = f0.v ...
+    string with, join, order;
+    for (size_t f = 0; f < parts.size(); ++f) {
+        string name = "f" + to_string(f);
+        with += (f == 0 ? "WITH " : ", ") + name + "(v, d) AS (VALUES ";
+        for (size_t i = 0; i < matches[f].size(); ++i) with += i == 0 ? "(?, ?)" : ", (?, ?)";
+        with += ")";
+        join += " JOIN " + name + " ON users." + sort_columns[f] + " = " + name + ".v";
+        order += (f == 0 ? "" : " + ") + name + ".d";
+    }
+    string query = with + " SELECT users.* FROM users" + join + " ORDER BY " + order + ", users.id LIMIT 500;";
+    auto bindMatches = [&](sqlite3_stmt* stmt) {
+        int n = 1;
+        for (const auto& field : matches) {
+            for (const auto& m : field) {
+                sqlite3_bind_text(stmt, n++, m.first.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_int(stmt, n++, m.second);
+            }
+        }
+    };
+    SQLiteStmt stmt(db, query);
+    bindMatches(stmt.get());
+    ResultCursor rows(stmt.get());
+    print(rows);
+
+    if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Записать найденные записи в файл\n\n2) Продолжить работу с базой данных без сохранения\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 1) {
+        saveToFile("fuzzy_search.txt", rows, false, "", "");
+    }
+}
+
+// Разделители полей и записей в сообщениях службы запросов
+const char field_sep = '\x1F';
+const char record_sep = '\x1E';
+
+// Наибольшая длина запроса к службе: запросы состоят из нескольких коротких полей
+const uint32_t max_request_size = 64 * 1024;
+
+// Инициализация сокетов (нужна только в Windows)
+bool initSockets() {
+#ifdef _WIN32
+    WSADATA wsa;
+    return WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+#else
+    return true;
+#endif
+}
+
+// Отправка и прием сообщений: 4 байта длины (little-endian) и содержимое
+bool sendAll(socket_t sock, const char* data, size_t len) {
+    while (len > 0) {
+        int n = send(sock, data, static_cast<int>(len), MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool recvAll(socket_t sock, char* data, size_t len) {
+    while (len > 0) {
+        int n = recv(sock, data, static_cast<int>(len), 0);
+        if (n <= 0) return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool sendFrame(socket_t sock, const string& payload) {
+    uint32_t len = static_cast<uint32_t>(payload.size());
+    char header[4] = { static_cast<char>(len), static_cast<char>(len >> 8), static_cast<char>(len >> 16), static_cast<char>(len >> 24) };
+    return sendAll(sock, header, 4) && sendAll(sock, payload.data(), payload.size());
+}
+
+// limit - наибольшая допустимая длина: сообщение длиннее не читается,
+// и прием завершается ошибкой (служба закрывает такое подключение)
+bool recvFrame(socket_t sock, string& payload, uint32_t limit = 0xFFFFFFFFu) {
+    unsigned char header[4];
+    if (!recvAll(sock, reinterpret_cast<char*>(header), 4)) return false;
+    uint32_t len = header[0] | (header[1] << 8) | (header[2] << 16) | (static_cast<uint32_t>(header[3]) << 24);
+    if (len > limit) return false;
+    payload.resize(len);
+    return len == 0 || recvAll(sock, &payload[0], len);
+}
+
+// Разбиение сообщения на части по разделителю
+vector<string> splitFields(const string& str, char sep) {
+    vector<string> out;
+    size_t start = 0;
+    while (true) {
+        size_t end = str.find(sep, start);
+        out.push_back(str.substr(start, end == string::npos ? string::npos : end - start));
+        if (end == string::npos) break;
+        start = end + 1;
+    }
+    return out;
+}
+
+// Адрес локального сокета службы
+sockaddr_un serviceAddress(const string& socket_path) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+// Подключение к службе запросов
+socket_t connectService(const string& socket_path) {
+    socket_t sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock == INVALID_SOCKET) return INVALID_SOCKET;
+    sockaddr_un addr = serviceAddress(socket_path);
+    if (connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        closeSocket(sock);
+        return INVALID_SOCKET;
+    }
+    return sock;
+}
+
+// Остановка службы запросов сигналом (SIGINT, SIGTERM): обработчик только
+// отмечает запрос и закрывает прием подключений, остальное делает QueryService::run
+volatile sig_atomic_t stop_requested = 0;
+socket_t service_listener = INVALID_SOCKET;
+
+void onStopSignal(int) {
+    stop_requested = 1;
+    if (service_listener != INVALID_SOCKET) shutdown(service_listener, SHUT_RDWR);
+}
+
+// Служба запросов: держит базу данных открытой, а подготовленные запросы - готовыми
+// к повторному использованию, и обслуживает клиентов через локальный сокет.
+// Каждый клиент обслуживается своим потоком, доступ к базе сериализуется мьютексом.
+// Формат запроса: код операции и поля через 0x1F:
+//   S вид значение          - поиск (вид: street, year, city, familiya)
+//   E вид значение файл     - поиск с записью результата в файл на стороне службы
+//   I строка                - добавление (строка в формате файла импорта)
+//   D id                    - удаление по ID
+// Ответ: '+' или '-' и данные; строки результата разделяются 0x1E, поля - 0x1F.
+// Служба общая для всех клиентов, поэтому по запросу клиента она не останавливается:
+// остановка - сигналом SIGINT или SIGTERM (Ctrl+C в консоли службы).
+class QueryService {
+    SQLiteDB db;
+    mutex db_mutex;
+    unique_ptr<SQLiteStmt> by_street, by_year, by_city, by_familiya, insert_stmt;
+    socket_t listener = INVALID_SOCKET;
+    bool stopping = false;
+    mutex clients_mutex;
+    vector<socket_t> clients;       // Подключения, которые обслуживаются сейчас
+    int active = 0;                 // Число работающих потоков клиентов
+    condition_variable idle;
+
+    // Подготовленный запрос поиска данного вида с привязанным значением
+    sqlite3_stmt* bindSearch(const string& kind, const string& value) {
+        sqlite3_stmt* stmt = nullptr;
+        if (kind == "street") {
+            stmt = by_street->get();
+            string pattern = "%" + value + "%";
+            sqlite3_bind_text(stmt, 1, pattern.c_str(), -1, SQLITE_TRANSIENT);
+        }
+        else if (kind == "year" && isDigitsOnly(value) && value.size() <= 4) {
+            stmt = by_year->get();
+            sqlite3_bind_int(stmt, 1, stoi(value));
+        }
+        else if (kind == "city") {
+            stmt = by_city->get();
+            sqlite3_bind_text(stmt, 1, value.c_str(), -1, SQLITE_TRANSIENT);
+        }
+        else if (kind == "familiya") {
+            stmt = by_familiya->get();
+            string upper = prefixSuccessor(value);
+            sqlite3_bind_text(stmt, 1, value.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, upper.empty() ? "\xFF" : upper.c_str(), -1, SQLITE_TRANSIENT);
+        }
+        return stmt;
+    }
+
+    string handle(const string& request) {
+        vector<string> f = splitFields(request, field_sep);
+        lock_guard<mutex> lock(db_mutex);
+        if (f[0] == "S" && f.size() == 3) {
+            sqlite3_stmt* stmt = bindSearch(f[1], f[2]);
+            if (!stmt) return u8"-Неизвестный вид поиска";
+            string out = "+";
+            bool first = true;
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                if (!first) out += record_sep;
+                first = false;
+                for (int col = 0; col < 7; ++col) {
+                    if (col > 0) out += field_sep;
+                    out += columnText(stmt, col);
+                }
+            }
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+            return out;
+        }
+        if (f[0] == "E" && f.size() == 4) {
+            if (!isValidFilename(f[3])) return u8"-Некорректное имя файла";
+            sqlite3_stmt* stmt = bindSearch(f[1], f[2]);
+            if (!stmt) return u8"-Неизвестный вид поиска";
+            string filename = f[3] + ".txt";
+            ResultCursor rows(stmt, false);
+            bool ok = write(filename, rows, false);
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+            if (!ok) return u8"-Не удалось открыть файл: " + filename;
+            registerReport(db.get(), filename, f[1] == "familiya" ? "prefix_familiya" : f[1], f[2], rows.position());
+            return "+" + filename;
+        }
+        if (f[0] == "I" && f.size() == 2) {
+            User u;
+            string error;
+            if (!parseImportLine(f[1], u, error)) return "-" + error;
+            sqlite3_stmt* stmt = insert_stmt->get();
+            sqlite3_bind_text(stmt, 1, u.familiya.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 2, u.imya.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 3, u.otchestvo.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_int(stmt, 4, u.godrozh);
+            sqlite3_bind_text(stmt, 5, u.adres.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 6, u.mesto.c_str(), -1, SQLITE_STATIC);
+            int rc = sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+            if (rc != SQLITE_DONE) return "-" + string(sqlite3_errmsg(db.get()));
+            return "+" + to_string(sqlite3_last_insert_rowid(db.get()));
+        }
+        if (f[0] == "D" && f.size() == 2 && isDigitsOnly(f[1])) {
+            SQLiteStmt stmt(db.get(), "DELETE FROM users WHERE id = ?;");
+            sqlite3_bind_int(stmt.get(), 1, stoi(f[1]));
+            if (sqlite3_step(stmt.get()) != SQLITE_DONE) return "-" + string(sqlite3_errmsg(db.get()));
+            return "+" + to_string(sqlite3_changes(db.get()));
+        }
+        return u8"-Некорректный запрос";
+    }
+
+    void serveClient(socket_t client) {
+        string request;
+        while (recvFrame(client, request, max_request_size)) {
+            if (!sendFrame(client, handle(request))) break;
+        }
+        // Поток отсоединен: подключение закрывается и убирается из списка здесь же
+        lock_guard<mutex> lock(clients_mutex);
+        clients.erase(find(clients.begin(), clients.end(), client));
+        closeSocket(client);
+        if (--active == 0) idle.notify_all();
+    }
+public:
+    QueryService(const string& db_name) : db(db_name) {
+        ensureJournal(db.get());
+        ensureIndexes(db.get());
+        by_street.reset(new SQLiteStmt(db.get(), "SELECT * FROM users WHERE adres LIKE ?;"));
+        by_year.reset(new SQLiteStmt(db.get(), "SELECT * FROM users WHERE godrozh = ?;"));
+        by_city.reset(new SQLiteStmt(db.get(), "SELECT * FROM users WHERE mesto = ?;"));
+        by_familiya.reset(new SQLiteStmt(db.get(), "SELECT * FROM users WHERE familiya >= ? AND familiya < ? ORDER BY familiya, id;"));
+        insert_stmt.reset(new SQLiteStmt(db.get(), "INSERT INTO users (familiya, imya, otchestvo, godrozh, adres, mesto) VALUES (?, ?, ?, ?, ?, ?);"));
+    }
+
+    void stop() {
+        lock_guard<mutex> lock(clients_mutex);
+        stopping = true;
+        if (listener != INVALID_SOCKET) shutdown(listener, SHUT_RDWR);
+        for (socket_t c : clients) shutdown(c, SHUT_RDWR);
+    }
+
+    bool run(const string& socket_path) {
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener == INVALID_SOCKET) {
+            cerr << u8"Не удалось создать сокет" << endl;
+            return false;
+        }
+        remove(socket_path.c_str());
+        sockaddr_un addr = serviceAddress(socket_path);
+        if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listener, 64) != 0) {
+            cerr << u8"Не удалось открыть сокет: " << socket_path << endl;
+            closeSocket(listener);
+            return false;
+        }
+        service_listener = listener;
+        signal(SIGINT, onStopSignal);
+        signal(SIGTERM, onStopSignal);
+        cout << u8"Служба запросов запущена: " << socket_path << endl;
+
+        while (true) {
+            socket_t client = accept(listener, nullptr, nullptr);
+            unique_lock<mutex> lock(clients_mutex);
+            if (stopping || stop_requested) {
+                if (client != INVALID_SOCKET) closeSocket(client);
+                break;
+            }
+            if (client == INVALID_SOCKET) {
+                // Временная ошибка приема (прерывание, нехватка дескрипторов)
+                // не останавливает службу: прием повторяется после паузы
+                lock.unlock();
+                this_thread::sleep_for(chrono::milliseconds(50));
+                continue;
+            }
+            clients.push_back(client);
+            ++active;
+            // Завершившийся поток сразу освобождает свой стек
+            thread(&QueryService::serveClient, this, client).detach();
+        }
+        stop();
+        {
+            unique_lock<mutex> lock(clients_mutex);
+            idle.wait(lock, [this]() { return active == 0; });
+        }
+        service_listener = INVALID_SOCKET;
+        closeSocket(listener);
+        remove(socket_path.c_str());
+        lock_guard<mutex> lock(db_mutex);
+        syncStats(db.get());
+        cout << u8"Служба запросов остановлена" << endl;
+        return true;
+    }
+};
+
+// Отправка запроса службе и получение ответа
+bool serviceCall(socket_t sock, const string& request, string& response) {
+    return sendFrame(sock, request) && recvFrame(sock, response);
+}
+
+// Нагрузочный тест службы: clients параллельных подключений по requests запросов поиска по году.
+// Выводит число запросов в секунду и перцентили задержки.
+void loadTest(const string& socket_path, int clients, int requests) {
+    vector<vector<double>> latencies(clients);
+    vector<thread> pool;
+    auto started = chrono::steady_clock::now();
+    for (int c = 0; c < clients; ++c) {
+        pool.emplace_back([&, c]() {
+            socket_t sock = connectService(socket_path);
+            if (sock == INVALID_SOCKET) return;
+            mt19937 rng(c);
+            string response;
+            for (int i = 0; i < requests; ++i) {
+                string request = string("S") + field_sep + "year" + field_sep + to_string(1930 + rng() % 78);
+                auto t0 = chrono::steady_clock::now();
+                if (!serviceCall(sock, request, response)) break;
+                latencies[c].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count());
+            }
+            closeSocket(sock);
+            });
+    }
+    for (auto& t : pool) t.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+    vector<double> all;
+    for (const auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+    if (all.empty()) {
+        cout << u8"Служба запросов недоступна: " << socket_path << endl;
+        return;
+    }
+    sort(all.begin(), all.end());
+    auto percentile = [&](double q) { return all[static_cast<size_t>(q * (all.size() - 1))]; };
+    cout << u8"Выполнено запросов: " << all.size() << u8" за " << seconds << u8" с" << endl;
+    cout << u8"Запросов в секунду: " << static_cast<int64_t>(all.size() / seconds) << endl;
+    cout << u8"Задержка, мкс: p50 = " << percentile(0.5) << ", p90 = " << percentile(0.9)
+        << ", p99 = " << percentile(0.99) << ", max = " << all.back() << endl;
+}
+
+// Запрос вида и значения поиска для клиента службы
+bool askServiceSearch(string& kind, string& value) {
+    int v = getMenuChoice(u8"\nВыберите параметр для поиска: \n-------------------------------------------------\n1) Улица\n\n2) Год рождения\n\n3) Город рождения\n\n4) Начало фамилии\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+    if (v < 1 || v > 4) {
+        cout << u8"Некорректный выбор!" << endl;
+        return false;
+    }
+    const char* kinds[] = { "street", "year", "city", "familiya" };
+    kind = kinds[v - 1];
+    cout << u8"Введите значение для поиска: ";
+    cin.ignore(10000, '\n');
+    getline(cin, value);
+    if (kind == "year" && (!isDigitsOnly(value) || value.length() != 4)) {
+        cout << u8"Год рождения должен быть четырехзначным числом!" << endl;
+        return false;
+    }
+    if ((kind == "city" && !isRussianLettersOnly(value)) || (kind == "familiya" && !isCorrectSecondname(value)) || value.empty()) {
+        cout << u8"Некорректное значение!" << endl;
+        return false;
+    }
+    if (kind == "familiya") value = capitalizeFirst(value);
+    return true;
+}
+
+// Работа с базой данных через запущенную службу запросов (тонкий клиент)
+void serviceClient(const string& socket_path) {
+    socket_t sock = connectService(socket_path);
+    if (sock == INVALID_SOCKET) {
+        cout << u8"Служба запросов не запущена (" << socket_path << u8"). Запустите программу с параметром --serve <база данных>" << endl;
+        return;
+    }
+    string response;
+    while (true) {
+        int choice = getMenuChoice(u8"\n\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Найти избирателей\n\n2) Найти и записать результат в файл\n\n3) Добавить избирателя\n\n4) Удалить пользователя по ID\n\n5) Назад\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+        string request, kind, value;
+        if (choice == 1) {
+            if (!askServiceSearch(kind, value)) continue;
+            request = string("S") + field_sep + kind + field_sep + value;
+        }
+        else if (choice == 2) {
+            if (!askServiceSearch(kind, value)) continue;
+            string filename;
+            cout << u8"Введите название файла для записи данных: ";
+            getline(cin, filename);
+            request = string("E") + field_sep + kind + field_sep + value + field_sep + filename;
+        }
+        else if (choice == 3) {
+            cout << u8"Введите данные в формате Фамилия;Имя;Отчество;Год;Улица Дом Квартира;Место: ";
+            cin.ignore(10000, '\n');
+            getline(cin, value);
+            request = string("I") + field_sep + value;
+        }
+        else if (choice == 4) {
+            int id = getMenuChoice(u8"\nВведите ID пользователя для удаления: ");
+            request = string("D") + field_sep + to_string(id);
+        }
+        else if (choice == 5) {
+            break;
+        }
+        else {
+            cout << u8"Некорректный выбор!" << endl;
+            continue;
+        }
+
+        if (!serviceCall(sock, request, response) || response.empty()) {
+            cout << u8"Связь со службой запросов потеряна" << endl;
+            break;
+        }
+        if (response[0] == '-') {
+            cout << u8"Ошибка: " << response.substr(1) << endl;
+            continue;
+        }
+        string body = response.substr(1);
+        if (choice == 1) {
+            if (body.empty()) {
+                cout << u8"\nНе найдены данные, удовлетворяющие введенному критерию!";
+                continue;
+            }
+            printTableHeader(cout);
+            for (const auto& row : splitFields(body, record_sep)) {
+                vector<string> f = splitFields(row, field_sep);
+                if (f.size() != 7) continue;
+                printRow(cout, stoi(f[0]), f[1], f[2], f[3], stoi(f[4]), f[5], f[6]);
+            }
+        }
+        else if (choice == 2) cout << u8"\nРезультат сохранен в файл: " << body << endl;
+        else if (choice == 3) cout << u8"Данные успешно добавлены в базу данных, ID: " << body << endl;
+        else if (choice == 4) cout << (body == "0" ? u8"Пользователь не найден в базе данных." : u8"Данные успешно удалены из базы данных.") << endl;
+    }
+    closeSocket(sock);
+}
+
+// Сверка текущей базы со свежим списком избирателей из другой базы.
+// Обе таблицы читаются потоком в порядке естественного ключа и сливаются
+// за один линейный проход: записи только в новой базе - добавленные,
+// только в текущей - удаленные, с одинаковым ключом, но другим адресом
+// или местом рождения - измененные. Изменения можно применить одной транзакцией.
+void reconcileDatabases(sqlite3* db) {
+    string fresh_name;
+    do {
+        cout << u8"Введите имя базы данных с новым списком избирателей: ";
+        cin.ignore(10000, '\n');
+        getline(cin, fresh_name);
+        if (!isValidFilename(fresh_name)) {
+            cin.sync();
+            pressEnter();
+            cout << u8"Имя базы данных должно содержать только буквы, цифры, подчеркивание или точку!\n";
+        }
+    } while (!isValidFilename(fresh_name));
+    fresh_name += ".db";
+    {
+        ifstream check(fresh_name);
+        if (!check) {
+            cout << u8"Ошибка открытия базы данных: " << fresh_name << endl;
+            return;
+        }
+    }
+
+    SQLiteStmt attach(db, "ATTACH DATABASE ? AS fresh;");
+    sqlite3_bind_text(attach.get(), 1, fresh_name.c_str(), -1, SQLITE_STATIC);
+    if (sqlite3_step(attach.get()) != SQLITE_DONE) {
+        cerr << u8"Ошибка SQLite: " << sqlite3_errmsg(db) << endl;
+        return;
+    }
+
+    vector<User> added, removed, changed;
+    auto started = chrono::steady_clock::now();
+    {
+        SQLiteStmt check(db, "SELECT COUNT(*) FROM fresh.sqlite_master WHERE type = 'table' AND name = 'users';");
+        if (sqlite3_step(check.get()) != SQLITE_ROW || sqlite3_column_int(check.get(), 0) == 0) {
+            cout << u8"В базе данных " << fresh_name << u8" нет таблицы избирателей" << endl;
+            sqlite3_exec(db, "DETACH DATABASE fresh;", nullptr, nullptr, nullptr);
+            return;
+        }
+        SQLiteStmt ours(db, "SELECT id, familiya, imya, otchestvo, godrozh, adres, mesto FROM main.users "
+            "ORDER BY familiya, imya, otchestvo, godrozh, adres, mesto, id;");
+        SQLiteStmt theirs(db, "SELECT id, familiya, imya, otchestvo, godrozh, adres, mesto FROM fresh.users "
+            "ORDER BY familiya, imya, otchestvo, godrozh, adres, mesto, id;");
+        auto next = [](sqlite3_stmt* stmt, User& u) {
+            if (sqlite3_step(stmt) != SQLITE_ROW) return false;
+            u.id = sqlite3_column_int(stmt, 0);
+            readUserColumns(stmt, 1, u);
+            return true;
+        };
+        User a, b;
+        bool has_a = next(ours.get(), a), has_b = next(theirs.get(), b);
+        while (has_a || has_b) {
+            int c = !has_a ? 1 : (!has_b ? -1 : compareNaturalKey(a, b));
+            if (c < 0) {
+                removed.push_back(a);
+                has_a = next(ours.get(), a);
+            }
+            else if (c > 0) {
+                added.push_back(b);
+                has_b = next(theirs.get(), b);
+            }
+            else {
+                // Тезки с тем же годом рождения: ID другой базы ничего не значат,
+                // поэтому сначала в пары ставятся совпадающие записи (строки идут
+                // по адресу и месту рождения), а оставшиеся считаются изменившимися
+                vector<User> ours_group, theirs_group;
+                const User key = a;
+                while (has_a && compareNaturalKey(a, key) == 0) {
+                    ours_group.push_back(a);
+                    has_a = next(ours.get(), a);
+                }
+                while (has_b && compareNaturalKey(b, key) == 0) {
+                    theirs_group.push_back(b);
+                    has_b = next(theirs.get(), b);
+                }
+                vector<User> left, right;
+                size_t i = 0, j = 0;
+                while (i < ours_group.size() && j < theirs_group.size()) {
+                    int d = ours_group[i].adres.compare(theirs_group[j].adres);
+                    if (d == 0) d = ours_group[i].mesto.compare(theirs_group[j].mesto);
+                    if (d == 0) {
+                        ++i;
+                        ++j;
+                    }
+                    else if (d < 0) left.push_back(ours_group[i++]);
+                    else right.push_back(theirs_group[j++]);
+                }
+                left.insert(left.end(), ours_group.begin() + i, ours_group.end());
+                right.insert(right.end(), theirs_group.begin() + j, theirs_group.end());
+                size_t k = 0;
+                for (; k < left.size() && k < right.size(); ++k) {
+                    right[k].id = left[k].id;
+                    changed.push_back(right[k]);
+                }
+                for (size_t r = k; r < left.size(); ++r) removed.push_back(left[r]);
+                for (size_t r = k; r < right.size(); ++r) added.push_back(right[r]);
+            }
+        }
+    }
+    sqlite3_exec(db, "DETACH DATABASE fresh;", nullptr, nullptr, nullptr);
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
+
+    {
+        FileBatch batch;
+        writeUsers("reconcile_added.txt", added, batch);
+        writeUsers("reconcile_removed.txt", removed, batch);
+        writeUsers("reconcile_changed.txt", changed, batch);
+        batch.commit();
+    }
+    cout << u8"\nСверка выполнена за " << elapsed << u8" мс" << endl;
+    cout << u8"Новых избирателей: " << added.size() << u8" (reconcile_added.txt)" << endl;
+    cout << u8"Выбывших избирателей: " << removed.size() << u8" (reconcile_removed.txt)" << endl;
+    cout << u8"Изменивших адрес или место рождения: " << changed.size() << u8" (reconcile_changed.txt)" << endl;
+    if (added.empty() && removed.empty() && changed.empty()) return;
+
+    if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Применить изменения к базе данных\n\n2) Продолжить без изменения базы данных\n-------------------------------------------------\nВведите цифру подпункта меню: ") != 1) {
+        return;
+    }
+    sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+    bool ok = true;
+    {
+        SQLiteStmt insert(db, "INSERT INTO users (familiya, imya, otchestvo, godrozh, adres, mesto) VALUES (?, ?, ?, ?, ?, ?);");
+        for (size_t i = 0; ok && i < added.size(); ++i) {
+            const User& u = added[i];
+            sqlite3_bind_text(insert.get(), 1, u.familiya.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(insert.get(), 2, u.imya.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(insert.get(), 3, u.otchestvo.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_int(insert.get(), 4, u.godrozh);
+            sqlite3_bind_text(insert.get(), 5, u.adres.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(insert.get(), 6, u.mesto.c_str(), -1, SQLITE_STATIC);
+            ok = sqlite3_step(insert.get()) == SQLITE_DONE;
+            sqlite3_reset(insert.get());
+        }
+        SQLiteStmt del(db, "DELETE FROM users WHERE id = ?;");
+        for (size_t i = 0; ok && i < removed.size(); ++i) {
+            sqlite3_bind_int(del.get(), 1, removed[i].id);
+            ok = sqlite3_step(del.get()) == SQLITE_DONE;
+            sqlite3_reset(del.get());
+        }
+        SQLiteStmt update(db, "UPDATE users SET adres = ?, mesto = ? WHERE id = ?;");
+        for (size_t i = 0; ok && i < changed.size(); ++i) {
+            sqlite3_bind_text(update.get(), 1, changed[i].adres.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(update.get(), 2, changed[i].mesto.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_int(update.get(), 3, changed[i].id);
+            ok = sqlite3_step(update.get()) == SQLITE_DONE;
+            sqlite3_reset(update.get());
+        }
+    }
+    if (!ok) {
+        cerr << u8"Ошибка изменения базы данных: " << sqlite3_errmsg(db) << endl;
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return;
+    }
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+    syncStats(db);
+    syncBitmaps(db);
+    cout << u8"Изменения применены к базе данных." << endl;
+}
+
+// Построение отчетов по секциям за один проход по таблице.
+// Вызывающий поток читает таблицу в порядке ID и раздает строки потокам
+// форматирования по хешу ключа секции, поэтому каждая секция целиком
+// принадлежит одному потоку и строки в ее файле остаются упорядоченными по ID.
+// Каждый поток копит текст своих секций в буферах и дописывает их в файлы
+// крупными блоками, не удерживая открытыми сотни файлов одновременно.
+// Готовые файлы регистрируются как отчеты и далее обновляются по журналу.
+void partitionReports(sqlite3* db) {
+    int by = getMenuChoice(u8"\nВыберите признак разбиения: \n-------------------------------------------------\n1) Место рождения\n\n2) Десятилетие рождения\n\n3) Улица\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+    if (by < 1 || by > 3) {
+        cout << u8"Некорректный выбор!\n";
+        return;
+    }
+    const char* prefixes[] = { "city_", "decade_", "street_" };
+    // Секция улицы - точное совпадение названия, а не поиск подстроки в адресе
+    const char* kinds[] = { "city", "decade", "street_exact" };
+    const size_t flush_size = 256 << 10;
+
+    struct Partition {
+        string key, filename;
+        ostringstream text;
+        long long rows = 0;
+        bool started = false;
+        bool failed = false;
+    };
+    // Порция строк для потока и имена файлов секций, впервые встреченных в ней
+    struct Chunk {
+        vector<User> rows;
+        map<string, string> filenames;
+    };
+    struct Worker {
+        map<string, unique_ptr<Partition>> partitions;
+        map<string, string> filenames;
+        BoundedQueue<Chunk> queue{ 8 };
+        thread th;
+    };
+
+    // Запись накопленного текста секции в конец ее временного файла
+    auto flushPartition = [](Partition& p) {
+        string text = p.text.str();
+        if (text.empty()) return;
+        ofstream file(FileBatch::tempName(p.filename), p.started ? ios::app : ios::trunc);
+        file.write(text.data(), text.size());
+        file.close();
+        if (!file) p.failed = true;
+        p.started = true;
+        p.text.str("");
+    };
+
+    unsigned count = thread::hardware_concurrency();
+    if (count == 0) count = 2;
+    if (count > 8) count = 8;
+    vector<unique_ptr<Worker>> workers;
+    for (unsigned i = 0; i < count; ++i) {
+        workers.emplace_back(new Worker);
+        Worker& w = *workers.back();
+        w.th = thread([&w, &flushPartition, by, flush_size] {
+            PROFILE_SCOPE(ProfileExport);
+            Chunk chunk;
+            while (w.queue.pop(chunk)) {
+                w.filenames.insert(chunk.filenames.begin(), chunk.filenames.end());
+                for (const auto& u : chunk.rows) {
+                    string key = partitionKey(by, u);
+                    unique_ptr<Partition>& p = w.partitions[key];
+                    if (!p) {
+                        p.reset(new Partition);
+                        p->key = key;
+                        p->filename = w.filenames[key];
+                        printTableHeader(p->text);
+                    }
+                    printRow(p->text, u.id, u.familiya, u.imya, u.otchestvo, u.godrozh, u.adres, u.mesto);
+                    ++p->rows;
+                    if (static_cast<size_t>(p->text.tellp()) >= flush_size) flushPartition(*p);
+                }
+            }
+            for (auto& entry : w.partitions) flushPartition(*entry.second);
+            });
+    }
+
+    // Имена файлов назначаются здесь, в одном потоке: после замены недопустимых
+    // символов разные ключи могут дать одно имя ("8-го Марта" и "8 го Марта"),
+    // и тогда к имени добавляется хеш ключа
+    map<string, string> filenames;
+    set<string> used;
+    auto filenameOf = [&](const string& key) {
+        string name = prefixes[by - 1] + key;
+        for (auto& c : name) {
+            unsigned char b = c;
+            if (b < 0x80 && !isValidFilename(string(1, c))) c = '_';
+        }
+        if (!isValidFilename(name)) name = prefixes[by - 1] + to_string(hashString(key) % 1000000);
+        string unique = name;
+        for (int i = 1; used.count(unique + ".txt"); ++i) {
+            unique = name + "_" + to_string((hashString(key) + i - 1) % 1000000);
+        }
+        used.insert(unique + ".txt");
+        return unique + ".txt";
+    };
+
+    auto started = chrono::steady_clock::now();
+    sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+    long long position = journalPosition(db);
+    {
+        SQLiteStmt stmt(db, "SELECT id, familiya, imya, otchestvo, godrozh, adres, mesto FROM users ORDER BY id;");
+        vector<Chunk> chunks(count);
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+            User u;
+            u.id = sqlite3_column_int(stmt.get(), 0);
+            readUserColumns(stmt.get(), 1, u);
+            string key = partitionKey(by, u);
+            unsigned target = static_cast<unsigned>(hashString(key) % count);
+            auto name = filenames.find(key);
+            if (name == filenames.end()) {
+                name = filenames.insert({ key, filenameOf(key) }).first;
+                chunks[target].filenames.insert(*name);
+            }
+            chunks[target].rows.push_back(move(u));
+            if (chunks[target].rows.size() == 1024) {
+                workers[target]->queue.push(move(chunks[target]));
+                chunks[target] = Chunk();
+            }
+        }
+        for (unsigned i = 0; i < count; ++i) {
+            if (!chunks[i].rows.empty()) workers[i]->queue.push(move(chunks[i]));
+        }
+    }
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+    for (auto& w : workers) {
+        w->queue.close();
+        w->th.join();
+    }
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
+
+    // Все файлы секций заменяются одной группой с общим барьером записи
+    FileBatch batch;
+    vector<const Partition*> written;
+    for (auto& w : workers) {
+        for (auto& entry : w->partitions) {
+            const Partition& p = *entry.second;
+            if (p.failed) {
+                cerr << u8"Ошибка записи файла: " << p.filename << endl;
+                remove(FileBatch::tempName(p.filename).c_str());
+                continue;
+            }
+            batch.add(p.filename);
+            written.push_back(&p);
+        }
+    }
+    long long rows = 0;
+    int files = 0;
+    if (batch.commit()) {
+        for (const Partition* p : written) {
+            registerReport(db, p->filename, kinds[by - 1], p->key, position);
+            rows += p->rows;
+            ++files;
+        }
+    }
+    cout << u8"\nСоздано файлов: " << files << u8", строк: " << rows << u8", время: " << elapsed << u8" мс" << endl;
+}
+
+// Составной фильтр по году рождения, городу и улице. Условия объединяются
+// слева направо операциями И / ИЛИ над множествами ID без обращения к таблице;
+// строки читаются из базы только для просмотра или сохранения результата.
+void bitmapFilter(sqlite3* db) {
+    syncBitmaps(db);
+    RoaringBitmap result;
+    int op = 0;
+    string description;
+    while (true) {
+        int field = getMenuChoice(u8"\nВыберите условие: \n-------------------------------------------------\n1) Год рождения или диапазон лет (например, 1980-1989)\n\n2) Город рождения\n\n3) Улица\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+        if (field < 1 || field > 3) {
+            cout << u8"Некорректный выбор!\n";
+            continue;
+        }
+        string value;
+        cout << u8"Введите значение: ";
+        cin.ignore(10000, '\n');
+        getline(cin, value);
+        value = trim(value);
+        if (field == 1) {
+            size_t dash = value.find('-');
+            string from = value.substr(0, dash), to = dash == string::npos ? from : value.substr(dash + 1);
+            if (!isDigitsOnly(from) || !isDigitsOnly(to) || from.length() != 4 || to.length() != 4) {
+                cout << u8"Год рождения должен быть четырехзначным числом!\n";
+                continue;
+            }
+        }
+        else if (value.empty()) {
+            cout << u8"Значение не может быть пустым!\n";
+            continue;
+        }
+
+        RoaringBitmap term = bitmapTerm(field, value);
+        const char* names[] = { u8"год", u8"город", u8"улица" };
+        string condition = string(names[field - 1]) + " = " + value;
+        if (op == 0) {
+            result = term;
+            description = condition;
+        }
+        else {
+            result = op == 1 ? RoaringBitmap::intersect(result, term) : RoaringBitmap::unite(result, term);
+            description = "(" + description + (op == 1 ? u8" И " : u8" ИЛИ ") + condition + ")";
+        }
+        cout << description << ": " << result.cardinality() << endl;
+
+        op = getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Добавить условие через И\n\n2) Добавить условие через ИЛИ\n\n3) Завершить фильтр\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+        if (op != 1 && op != 2) break;
+    }
+
+    cout << u8"\nНайдено избирателей: " << result.cardinality() << endl;
+    if (result.empty()) return;
+    int v = getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Вывести найденных избирателей\n\n2) Сохранить в файл\n\n3) Продолжить работу с базой данных\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+    if (v != 1 && v != 2) return;
+
+    loadFilterIds(db, result);
+    SQLiteStmt stmt(db, filter_query);
+    ResultCursor rows(stmt.get());
+    if (v == 1) print(rows);
+    else saveToFile("filter.txt", rows, false, "", "", false);
+}
+
+// Поиск записи по ID в отчете с записями фиксированной длины
+void fixedReportLookup(sqlite3* db) {
+    string filename;
+    do {
+        cout << u8"Введите имя файла отчета (.tbl): ";
+        cin.ignore(10000, '\n');
+        getline(cin, filename);
+        if (!isValidFilename(filename)) {
+            cin.sync();
+            pressEnter();
+            cout << u8"Имя файла должно содержать только буквы, цифры, подчеркивание или точку!\n";
+        }
+    } while (!isValidFilename(filename));
+    filename += ".tbl";
+    syncReports(db, filename);
+
+    FixedReport report;
+    if (!report.open(filename)) {
+        cout << u8"Ошибка открытия файла или файл поврежден: " << filename << endl;
+        return;
+    }
+    cout << u8"Записей в файле: " << report.size() << u8", из них удалено: " << report.removedCount() << endl;
+    while (true) {
+        string id_str;
+        cout << u8"\nВведите ID (0 - завершить поиск): ";
+        cin >> id_str;
+        if (!isDigitsOnly(id_str)) {
+            cout << u8"ID должен быть положительным числом!\n";
+            continue;
+        }
+        int id = stoi(id_str);
+        if (id == 0) return;
+        long long index = report.find(id);
+        User u;
+        bool is_removed = false;
+        if (index < 0 || !report.read(index, u, is_removed) || is_removed) {
+            cout << u8"Запись с ID " << id << u8" в файле не найдена" << endl;
+            continue;
+        }
+        printTableHeader(cout);
+        printRow(cout, u.id, u.familiya, u.imya, u.otchestvo, u.godrozh, u.adres, u.mesto);
+    }
+}
+
+// Фильтрация файла отчета с сохранением результата в новый файл.
+// Условия и преобразования добавляются в потоковый конвейер, поэтому
+// файл любого размера обрабатывается построчно в постоянном объеме памяти.
+void filterReportFile(const string& source) {
+    ReportPipeline pipeline(source);
+    while (true) {
+        int field = getMenuChoice(u8"\nВыберите условие отбора: \n-------------------------------------------------\n1) Год рождения или диапазон лет (например, 1980-1989)\n\n2) Город рождения\n\n3) Улица\n\n4) Условия заданы\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+        if (field == 4) break;
+        if (field < 1 || field > 3) {
+            cout << u8"Некорректный выбор!\n";
+            continue;
+        }
+        string value;
+        cout << u8"Введите значение: ";
+        cin.ignore(10000, '\n');
+        getline(cin, value);
+        value = trim(value);
+        if (field == 1) {
+            size_t dash = value.find('-');
+            string from = value.substr(0, dash), to = dash == string::npos ? from : value.substr(dash + 1);
+            if (!isDigitsOnly(from) || !isDigitsOnly(to) || from.length() != 4 || to.length() != 4) {
+                cout << u8"Год рождения должен быть четырехзначным числом!\n";
+                continue;
+            }
+            int low = stoi(from), high = stoi(to);
+            pipeline.filter([low, high](const User& u) { return u.godrozh >= low && u.godrozh <= high; });
+        }
+        else if (value.empty()) {
+            cout << u8"Значение не может быть пустым!\n";
+        }
+        else if (field == 2) {
+            pipeline.filter([value](const User& u) { return u.mesto == value; });
+        }
+        else {
+            pipeline.filter([value](const User& u) { return u.adres.find(value) != string::npos; });
+        }
+    }
+    if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Сократить имя и отчество до инициалов\n\n2) Оставить ФИО полностью\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 1) {
+        pipeline.map([](User& u) {
+            u.imya = initialOf(u.imya);
+            u.otchestvo = initialOf(u.otchestvo);
+            });
+    }
+
+    int format = getMenuChoice(u8"\nВыберите формат файла: \n-------------------------------------------------\n1) Таблица (.txt)\n\n2) CSV (.csv)\n\n3) NDJSON - по одной записи JSON в строке (.ndjson)\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+    if (format < 1 || format > 3) {
+        cout << u8"Некорректный выбор!\n";
+        return;
+    }
+    format = format == 1 ? FormatTable : (format == 2 ? FormatCsv : FormatNdjson);
+    string target;
+    do {
+        cout << u8"Введите название файла для записи данных: ";
+        cin.ignore(10000, '\n');
+        getline(cin, target);
+        if (!isValidFilename(target)) {
+            cin.sync();
+            pressEnter();
+            cout << u8"Имя файла должно содержать только буквы, цифры, подчеркивание или точку!\n";
+        }
+    } while (!isValidFilename(target));
+    target += formatExtension(format);
+    if (target == source) {
+        cout << u8"Файл результата должен отличаться от исходного!" << endl;
+        return;
+    }
+
+    PROFILE_SCOPE(ProfileExport);
+    auto started = chrono::steady_clock::now();
+    // Отчет пишется во временный файл и заменяет прежний только целиком
+    string temp = FileBatch::tempName(target);
+    ofstream file(temp, ios::binary | ios::trunc);
+    if (!file) {
+        cout << u8"Ошибка создания файла: " << target << endl;
+        return;
+    }
+    long long count;
+    {
+        OutputBuffer out(file, 4 << 20);
+        if (format == FormatTable) printTableHeader(file);
+        RowWriter writer(out, format, { "id", "familiya", "imya", "otchestvo", "godrozh", "adres", "mesto" });
+        count = pipeline.run([&](const User& u) {
+            if (format == FormatTable) printRow(file, u.id, u.familiya, u.imya, u.otchestvo, u.godrozh, u.adres, u.mesto);
+            else writer.user(u);
+            });
+    }
+    file.close();
+    if (!file) {
+        cout << u8"Ошибка записи файла: " << target << endl;
+        remove(temp.c_str());
+        return;
+    }
+    FileBatch batch;
+    batch.add(target);
+    if (!batch.commit()) return;
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
+    cout << u8"\nОтобрано строк: " << count << u8", результат сохранен в файл " << target << " (" << elapsed << u8" мс)" << endl;
+}
+
+// Замер рабочих нагрузок текущей базы данных под каждым профилем хранения.
+// Для каждого профиля база копируется (backup API) во временный файл, к копии
+// применяется профиль вместе с размером страницы, после чего на новом подключении
+// выполняются поиск (по городам, годам и улицам из самой базы), полная выгрузка
+// в файл и вставка пакетами, как при импорте. Копии удаляются после замера.
+void tuneStorage(sqlite3* db) {
+    vector<string> cities, streets;
+    vector<int> years;
+    {
+        SQLiteStmt stmt(db, "SELECT DISTINCT mesto FROM users LIMIT 20;");
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW) cities.push_back(columnText(stmt.get(), 0));
+        SQLiteStmt year_stmt(db, "SELECT DISTINCT godrozh FROM users LIMIT 20;");
+        while (sqlite3_step(year_stmt.get()) == SQLITE_ROW) years.push_back(sqlite3_column_int(year_stmt.get(), 0));
+        SQLiteStmt street_stmt(db, "SELECT adres FROM users LIMIT 20;");
+        while (sqlite3_step(street_stmt.get()) == SQLITE_ROW) streets.push_back(streetOf(columnText(street_stmt.get(), 0)));
+    }
+    if (cities.empty()) {
+        cout << u8"База данных пуста - замерять нечего" << endl;
+        return;
+    }
+    const string copy_name = string(sqlite3_db_filename(db, "main")) + ".tune";
+    const string export_name = copy_name + ".txt";
+    const int insert_rows = 20000;
+
+    struct Result {
+        long long search, exporting, insert;
+    };
+    vector<Result> results;
+    cout << u8"\nЗамер выполняется на копии базы данных..." << endl;
+    for (const auto& p : storage_profiles) {
+        remove(copy_name.c_str());
+        remove((copy_name + "-wal").c_str());
+        remove((copy_name + "-shm").c_str());
+        {
+            SQLiteDB copy(copy_name);
+            sqlite3_backup* backup = sqlite3_backup_init(copy.get(), "main", db, "main");
+            if (!backup) {
+                cerr << u8"Ошибка копирования базы данных: " << sqlite3_errmsg(copy.get()) << endl;
+                return;
+            }
+            sqlite3_backup_step(backup, -1);
+            sqlite3_backup_finish(backup);
+            applyStorageProfile(copy.get(), p, true);
+        }
+
+        // Замеры идут на новом подключении, чтобы кеш страниц был холодным
+        SQLiteDB copy(copy_name);
+        applyStorageProfile(copy.get(), p, false);
+        Result r;
+        r.search = measureMs([&] {
+            SQLiteStmt by_city(copy.get(), "SELECT * FROM users WHERE mesto = ?;");
+            SQLiteStmt by_year(copy.get(), "SELECT * FROM users WHERE godrozh = ?;");
+            SQLiteStmt by_street(copy.get(), "SELECT * FROM users WHERE adres LIKE ?;");
+            for (size_t i = 0; i < 20; ++i) {
+                const string& city = cities[i % cities.size()];
+                string street = "%" + streets[i % streets.size()] + "%";
+                sqlite3_bind_text(by_city.get(), 1, city.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_int(by_year.get(), 1, years[i % years.size()]);
+                sqlite3_bind_text(by_street.get(), 1, street.c_str(), -1, SQLITE_STATIC);
+                for (sqlite3_stmt* stmt : { by_city.get(), by_year.get(), by_street.get() }) {
+                    while (sqlite3_step(stmt) == SQLITE_ROW) {}
+                    sqlite3_reset(stmt);
+                }
+            }
+            });
+        r.exporting = measureMs([&] {
+            SQLiteStmt stmt(copy.get(), "SELECT * FROM users;");
+            ofstream file(export_name, ios::trunc);
+            printTableHeader(file);
+            while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                User u;
+                u.id = sqlite3_column_int(stmt.get(), 0);
+                readUserColumns(stmt.get(), 1, u);
+                printRow(file, u.id, u.familiya, u.imya, u.otchestvo, u.godrozh, u.adres, u.mesto);
+            }
+            });
+        r.insert = measureMs([&] {
+            SQLiteStmt source(copy.get(), "SELECT familiya, imya, otchestvo, godrozh, adres, mesto FROM users LIMIT 1000;");
+            vector<User> sample;
+            while (sqlite3_step(source.get()) == SQLITE_ROW) {
+                User u;
+                readUserColumns(source.get(), 0, u);
+                sample.push_back(u);
+            }
+            SQLiteStmt insert(copy.get(), "INSERT INTO users (familiya, imya, otchestvo, godrozh, adres, mesto) VALUES (?, ?, ?, ?, ?, ?);");
+            for (int i = 0; i < insert_rows; ++i) {
+                if (i % 1000 == 0) sqlite3_exec(copy.get(), "BEGIN;", nullptr, nullptr, nullptr);
+                const User& u = sample[i % sample.size()];
+                sqlite3_bind_text(insert.get(), 1, u.familiya.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_text(insert.get(), 2, u.imya.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_text(insert.get(), 3, u.otchestvo.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_int(insert.get(), 4, u.godrozh);
+                sqlite3_bind_text(insert.get(), 5, u.adres.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_text(insert.get(), 6, u.mesto.c_str(), -1, SQLITE_STATIC);
+                sqlite3_step(insert.get());
+                sqlite3_reset(insert.get());
+                if (i % 1000 == 999 || i == insert_rows - 1) sqlite3_exec(copy.get(), "COMMIT;", nullptr, nullptr, nullptr);
+            }
+            });
+        results.push_back(r);
+        cout << "  " << p.name << u8": готово" << endl;
+    }
+    remove(copy_name.c_str());
+    remove((copy_name + "-wal").c_str());
+    remove((copy_name + "-shm").c_str());
+    remove(export_name.c_str());
+
+    int best = 0;
+    cout << u8"\nПрофиль      | Поиск, мс | Выгрузка, мс | Вставка " << insert_rows << u8" строк, мс | Всего, мс" << endl;
+    cout << u8"-----------------------------------------------------------------------------" << endl;
+    for (int i = 0; i < storage_profile_count; ++i) {
+        const Result& r = results[i];
+        long long total = r.search + r.exporting + r.insert;
+        const Result& b = results[best];
+        if (total < b.search + b.exporting + b.insert) best = i;
+        cout << left << setw(12) << storage_profiles[i].name << " | " << setw(9) << r.search << " | " << setw(12) << r.exporting
+            << " | " << setw(23) << r.insert << " | " << total << endl;
+    }
+    cout << u8"\nБыстрее всего: " << storage_profiles[best].name << " - " << storage_profiles[best].title << endl;
+    if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Применить этот профиль к базе данных\n\n2) Оставить текущий профиль\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 1
+        && setStorageProfile(db, storage_profiles[best])) {
+        cout << u8"Профиль хранения изменен." << endl;
+    }
+}
+
+// Выбор профиля хранения базы данных или подбор его замером
+void storageProfileMenu(sqlite3* db) {
+    const StorageProfile& current = findStorageProfile(storedProfileName(db));
+    cout << u8"\nТекущий профиль хранения: " << current.name << " - " << current.title << endl;
+    int v = getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Выбрать профиль хранения\n\n2) Подобрать профиль замером на копии базы данных\n\n3) Продолжить работу с базой данных\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+    if (v == 2) {
+        tuneStorage(db);
+        return;
+    }
+    if (v != 1) return;
+    string prompt = u8"\nВыберите профиль хранения: \n-------------------------------------------------\n";
+    for (int i = 0; i < storage_profile_count; ++i) {
+        prompt += to_string(i + 1) + ") " + storage_profiles[i].title + (i + 1 < storage_profile_count ? "\n\n" : "\n");
+    }
+    prompt += u8"-------------------------------------------------\nВведите цифру подпункта меню: ";
+    int choice = getMenuChoice(prompt);
+    if (choice < 1 || choice > storage_profile_count) {
+        cout << u8"Некорректный выбор!\n";
+        return;
+    }
+    if (setStorageProfile(db, storage_profiles[choice - 1])) {
+        cout << u8"Профиль хранения изменен." << endl;
+    }
+}
+
+// Возрастной состав и число избирателей по годам рождения. Ответы строятся
+// по индексу годов рождения в памяти и не обращаются к таблице users.
+// Дата рождения хранится с точностью до года, поэтому возрастом на дату
+// считается число лет, которое исполняется в году этой даты.
+void ageDistribution(sqlite3* db) {
+    syncBitmaps(db);
+    if (year_index.total() == 0) {
+        cout << u8"\nБаза данных пуста!" << endl;
+        return;
+    }
+    int v = getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Возрастной состав избирателей на дату\n\n2) Число избирателей по годам рождения (год или диапазон лет)\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+    if (v == 2) {
+        string value;
+        size_t dash;
+        do {
+            cout << u8"Введите год или диапазон лет (например, 1980-1989): ";
+            cin >> value;
+            dash = value.find('-');
+        } while (!isDigitsOnly(value.substr(0, dash)) || value.substr(0, dash).length() != 4 ||
+            (dash != string::npos && (!isDigitsOnly(value.substr(dash + 1)) || value.substr(dash + 1).length() != 4)));
+        int from = stoi(value.substr(0, dash));
+        int to = dash == string::npos ? from : stoi(value.substr(dash + 1));
+        if (from > to) swap(from, to);
+        cout << u8"\nГод  | Число" << endl;
+        for (int year = from; year <= to; ++year) {
+            int64_t count = year_index.count(year);
+            if (count > 0) cout << year << " | " << count << endl;
+        }
+        cout << u8"Всего родившихся в " << from << "-" << to << u8": " << year_index.countRange(from, to) << endl;
+        return;
+    }
+    if (v != 1) {
+        cout << u8"Некорректный выбор!\n";
+        return;
+    }
+
+    string date;
+    do {
+        cout << u8"Введите дату, на которую считается возраст (ДД.ММ.ГГГГ): ";
+        cin >> date;
+        if (!isValidDate(date)) {
+            cout << u8"Дата должна быть в формате ДД.ММ.ГГГГ!\n";
+        }
+    } while (!isValidDate(date));
+    vector<int> bounds = { 18, 25, 35, 45, 55, 65, 75 };
+    if (getMenuChoice(u8"\nВыберите возрастные группы: \n-------------------------------------------------\n1) Стандартные (младше 18, 18-24, 25-34, ..., 75 и старше)\n\n2) Задать границы групп\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 2) {
+        bool valid;
+        do {
+            cout << u8"Введите возрастные границы групп по возрастанию через пробел (например, 18 30 60): ";
+            cin.ignore(10000, '\n');
+            string line;
+            getline(cin, line);
+            bounds.clear();
+            valid = true;
+            istringstream words(line);
+            string word;
+            while (words >> word) {
+                if (!isDigitsOnly(word) || word.empty() || word.length() > 3 ||
+                    (!bounds.empty() && stoi(word) <= bounds.back())) {
+                    valid = false;
+                    break;
+                }
+                bounds.push_back(stoi(word));
+            }
+            if (bounds.empty() || bounds[0] == 0) valid = false;
+            if (!valid) {
+                cin.sync();
+                pressEnter();
+                cout << u8"Границы должны быть положительными числами по возрастанию!\n";
+            }
+        } while (!valid);
+    }
+
+    auto started = chrono::steady_clock::now();
+    ostringstream report;
+    writeAgeReport(report, date, bounds);
+    auto elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - started).count();
+    cout << endl << report.str() << u8"Отчет построен за " << elapsed << u8" мкс" << endl;
+
+    if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Записать отчет в файл\n\n2) Продолжить работу с базой данных без сохранения\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 1) {
+        string filename = "age_distribution.txt";
+        string temp = FileBatch::tempName(filename);
+        ofstream file(temp, ios::trunc);
+        file << report.str();
+        file.close();
+        if (!file) {
+            cerr << u8"Ошибка записи файла: " << filename << endl;
+            remove(temp.c_str());
+            return;
+        }
+        FileBatch batch;
+        batch.add(filename);
+        if (!batch.commit()) return;
+        cout << u8"\nРезультат сохранен в файл: " << filename << endl;
+    }
+}
+
+// Обработка операций с базой данных
+void work_db(int c, const string& table_name) {
+    SQLiteDB db(table_name);
+    string query, param, default_file, report_kind, report_param;
+    bool use_int = false;
+
+    switch (c) {
+    case 1:
+        query = "SELECT * FROM users;";
+        default_file = "all_users.txt";
+        break;
+    case 2:
+        do {
+            cout << u8"Введите название улицы: ";
+            cin.ignore(10000, '\n');
+            getline(cin, param);
+            if (param.empty()) {
+                cout << u8"Название улицы не может быть пустым!\n";
+            }
+        } while (param.empty());
+        query = "SELECT * FROM users WHERE adres LIKE ?;";
+        param = "%" + param + "%";
+        default_file = "adres_sort.txt";
+        report_kind = "street";
+        report_param = param.substr(1, param.length() - 2);
+        break;
+    case 3:
+        do {
+            cout << u8"Введите год рождения: ";
+            cin >> param;
+            if (!isDigitsOnly(param) || param.length() != 4 ||
+                (stoi(param) < 1900 || stoi(param) > 2025)) {
+                cout << u8"Год рождения должен быть четырехзначным числом от 1900 до 2025!\n";
+            }
+        } while (!isDigitsOnly(param) || param.length() != 4 ||
+            (stoi(param) < 1900 || stoi(param) > 2025));
+        // Строки года выбираются по индексу годов рождения, без просмотра всей таблицы
+        syncBitmaps(db.get());
+        if (year_index.count(stoi(param)) == 0) {
+            cout << u8"\nНе найдены данные, удовлетворяющие введенному критерию!";
+            return;
+        }
+        loadFilterIds(db.get(), bitmap_index.years[stoi(param)]);
+        query = filter_query;
+        default_file = "year_sort.txt";
+        use_int = true;
+        report_kind = "year";
+        report_param = param;
+        break;
+    case 4:
+        do {
+            cout << u8"Введите город рождения: ";
+            cin.ignore(10000, '\n');
+            getline(cin, param);
+            if (!isRussianLettersOnly(param)) {
+                cout << u8"Город рождения должен содержать только буквы!\n";
+            }
+        } while (!isRussianLettersOnly(param));
+        query = "SELECT * FROM users WHERE mesto = ?;";
+        default_file = "city_sort.txt";
+        report_kind = "city";
+        report_param = param;
+        break;
+    case 5:
+        sort_smth(table_name);
+        return;
+    case 7: {
+        SQLiteStmt stmt(db.get(), "SELECT * FROM users;");
+        ResultCursor rows(stmt.get(), false);
+        print(rows);
+        string id_str;
+        int id;
+        do {
+            cout << u8"\nВведите ID пользователя для удаления: ";
+            cin >> id_str;
+            if (!isDigitsOnly(id_str) || stoi(id_str) <= 0) {
+                cout << u8"ID должен быть положительным числом!\n";
+            }
+        } while (!isDigitsOnly(id_str) || stoi(id_str) <= 0);
+        id = stoi(id_str);
+        deleteUserById(db.get(), id);
+        return;
+    }
+    case 8: {
+        string filename;
+        do {
+            cout << u8"Введите имя файла для вывода в консоль: ";
+            cin.ignore(10000, '\n');
+            getline(cin, filename);
+            if (!isValidFilename(filename)) {
+                cin.sync();
+                pressEnter();
+                cout << u8"Имя файла должно содержать только буквы, цифры, подчеркивание или точку!\n";
+            }
+        } while (!isValidFilename(filename));
+        filename += ".txt";
+        syncReports(db.get(), filename);
+        {
+            ifstream check(filename);
+            if (!check) {
+                cout << u8"Ошибка открытия файла: " << filename << endl;
+                return;
+            }
+        }
+
+        cout << u8"\nДанные из файла:" << endl;
+        printTableHeader(cout);
+        long long count;
+        {
+            PROFILE_SCOPE(ProfileRender);
+            count = ReportPipeline(filename).run([](const User& u) {
+                printRow(cout, u.id, u.familiya, u.imya, u.otchestvo, u.godrozh, u.adres, u.mesto);
+                });
+        }
+        if (count <= 0) {
+            cout << u8"Файл пуст или содержит некорректные данные!" << endl;
+            return;
+        }
+        if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Отобрать строки файла и сохранить в новый файл\n\n2) Продолжить работу с базой данных\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 1) {
+            filterReportFile(filename);
+        }
+        return;
+    }
+    case 9: {
+        int updated = syncReports(db.get(), "");
+        cout << u8"\nОбновлено файлов отчетов: " << updated << endl;
+        return;
+    }
+    case 10: {
+        string filename;
+        do {
+            cout << u8"Введите имя файла для импорта (строки вида Фамилия;Имя;Отчество;Год;Улица Дом Квартира;Место): ";
+            cin.ignore(10000, '\n');
+            getline(cin, filename);
+            if (!isValidFilename(filename)) {
+                cin.sync();
+                pressEnter();
+                cout << u8"Имя файла должно содержать только буквы, цифры, подчеркивание или точку!\n";
+            }
+        } while (!isValidFilename(filename));
+        importVoters(db.get(), filename + ".txt");
+        return;
+    }
+    case 11:
+        showStats(db.get());
+        return;
+    case 12:
+        prefixSearch(db.get());
+        return;
+    case 13:
+        fuzzySearch(db.get());
+        return;
+    case 14:
+        showExportJobs();
+        return;
+    case 15:
+        reconcileDatabases(db.get());
+        return;
+    case 16:
+        partitionReports(db.get());
+        return;
+    case 17:
+        bitmapFilter(db.get());
+        return;
+    case 18:
+        fixedReportLookup(db.get());
+        return;
+    case 19:
+        storageProfileMenu(db.get());
+        return;
+    case 20:
+        ageDistribution(db.get());
+        return;
+    default:
+        cout << u8"Неверный выбор." << endl;
+        return;
+    }
+
+    SQLiteStmt stmt(db.get(), query);
+
+    if (c == 2 || c == 4) {
+        sqlite3_bind_text(stmt.get(), 1, param.c_str(), -1, SQLITE_STATIC);
+    }
+    // Полный вывод базы данных не сохраняется, поэтому строки не дописываются на диск
+    ResultCursor rows(stmt.get(), c != 1);
+    if ((c == 2 || c == 4) && rows.empty()) {
+        cout << u8"\nНе найдены данные, удовлетворяющие введенному критерию!";
+        return;
+    }
+    print(rows);
+
+    if (c != 1) {
+        if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Записать базу данных по найденному параметру в файл\n\n2) Продолжить работу с базой данных без сохранения\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 1) {
+            saveToFile(default_file, rows, false, report_kind, report_param, c != 3);
+        }
+    }
+}
+
+// Создание или дополнение базы данных
+void create_db(const string& name) {
+    SQLiteDB db(name);
+    if (sqlite3_exec(db.get(), users_table_sql, nullptr, nullptr, nullptr) != SQLITE_OK) {
+        cerr << u8"Ошибка создания таблицы: " << sqlite3_errmsg(db.get()) << endl;
+        return;
+    }
+    if (!ensureJournal(db.get()) || !ensureIndexes(db.get())) return;
+
+    int count = getMenuChoice(u8"Укажите кол-во вводимых избирателей: ");
+    for (int i = 0; i < count; ++i) {
+        string familiya, imya, otchestvo, prev_adres, mesto, godrozh_str, adres = "";
+        int godrozh;
+
+        // Ввод фамилии
+        do {
+            cin.clear();
+            cin.ignore(1000, '\n');
+            cout << u8"Введите фамилию: ";
+            getline(cin, familiya); 
+            if (!isCorrectSecondname(familiya) or !firstTrue(familiya)) {
+                cout << u8"Фамилия должна содержать только русские буквы или дефис и начинаться с заглавной буквы!";
+                cin.sync();
+                pressEnter();
+            }
+            else {
+                pressEnter();
+                break;
+            }
+        } while (true);
+
+        // Ввод имени
+        do {
+            cin.clear();
+            cin.ignore(1000, '\n');
+            cout << u8"Введите имя: ";
+            getline(cin, imya);
+            if (!isRussianLettersOnly(imya) or !firstTrue(imya)) {
+                cout << u8"Имя должно содержать только русские буквы и начинаться с заглавной буквы!";
+                cin.sync();
+                pressEnter();
+            }
+            else {
+                pressEnter();
+                break;
+            }
+        } while (true);
+
+        // Ввод отчества
+        do {
+            cin.clear();
+            cin.ignore(1000, '\n');
+            cout << u8"Введите отчество: ";
+            getline(cin, otchestvo);
+            if (!isRussianLettersOnly(otchestvo) or !firstTrue(otchestvo)) {
+                cout << u8"Отчество должно содержать только русские буквы и начинаться с заглавной буквы!";
+                cin.sync();
+                pressEnter();
+            }
+            else {
+                pressEnter();
+                cin.ignore(100, '\n');
+                break;
+            }
+        } while (true);
+
+        // Ввод года рождения
+        do {
+            cout << u8"Введите год рождения: ";
+            cin.clear();
+            getline(cin, godrozh_str);
+            try {
+                godrozh = stoi(godrozh_str);
+                if (godrozh < 1930 || godrozh > 2007) {
+                    cout << u8"Год рождения должен быть от 1930 до 2007!\n";
+                    continue;
+                }
+                break;
+            }
+            catch (const exception& e) {
+                cout << u8"Введите корректное число!\n";
+            }
+        } while (true);
+        cout << endl;
+        // Ввод адреса
+        do {
+            cout << u8"Введите название улицы, номер дома и номер квартиры через пробел(пример: Ленина 64 5): ";
+            cin.clear();
+            cin.sync();
+            getline(cin, prev_adres);
+            if (!(firstTrue(prev_adres))) {
+                cout << u8"Неверный формат адреса! Проверьте заглавную букву в названии улицы " << endl;
+            }
+            else {
+                if (normalizeAddress(prev_adres, adres)) {
+                    pressEnter();
+                    break;
+                }
+                else {
+                    cout << u8"Неверный формат адреса! Введите заново в формате улица, номер дома и номер квартиры" << endl;
+                }
+            }
+        } while (true);
+
+        // Ввод места рождения
+        do {
+            cin.clear();
+            cin.ignore(1000, '\n');
+            cout << u8"Введите место рождения: ";
+            getline(cin, mesto);
+            if (!isRussianLettersOnly(mesto) or !firstTrue(mesto)) {
+                cout << u8"Место рождения должно содержать только русские буквы или пробел и начинаться с заглавной буквы!";
+                cin.sync();
+                pressEnter();
+            }
+            else {
+                pressEnter();
+                break;
+            }
+        } while (true);
+
+        SQLiteStmt stmt(db.get(), "INSERT INTO users (familiya, imya, otchestvo, godrozh, adres, mesto) VALUES (?, ?, ?, ?, ?, ?);");
+        sqlite3_bind_text(stmt.get(), 1, familiya.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), 2, imya.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), 3, otchestvo.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt.get(), 4, godrozh);
+        sqlite3_bind_text(stmt.get(), 5, adres.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt.get(), 6, mesto.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt.get()) != SQLITE_DONE) {
+            cerr << u8"Ошибка добавления данных: " << sqlite3_errmsg(db.get()) << endl;
+            continue;
+        }
+        cout << u8"Данные успешно добавлены в базу данных." << endl;
+    }
+    syncStats(db.get());
+    syncBitmaps(db.get());
+}
+
+// Работа с существующей базой данных
+void later_db(const string& table_name) {
+    if (table_name == "list_voiters1.db") {
+        cout << u8"\n\n\t\t\t\tВыбрана функция работы с предустановленной базой данных" << endl;
+    }
+    else {
+        cout << u8"\n\n\t\t\tВыбрана функция работы с созданной базой данных" << endl;
+    }
+    {
+        SQLiteDB db(table_name);
+        ensureJournal(db.get());
+        ensureIndexes(db.get());
+        syncBitmaps(db.get());
+    }
+    while (true) {
+        int choice = getMenuChoice(u8"\n\n\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Вывести базу данных в консоль\n\n2) Найти по улице, на которой проживает избиратель\n\n3) Найти по году рождения избирателя\n\n4) Найти по городу рождения избирателя\n\n5) Отсортировать базу данных или файл\n\n6) Дополнить базу данных\n\n7) Удалить пользователя по ID\n\n8) Вывести содержимое файла из директории\n\n9) Обновить файлы отчетов по журналу изменений\n\n10) Импортировать избирателей из файла\n\n11) Статистика по избирателям\n\n12) Поиск по началу фамилии или имени\n\n13) Нечеткий поиск по ФИО\n\n14) Фоновые выгрузки\n\n15) Сверка с новым списком избирателей\n\n16) Отчеты по городам, десятилетиям рождения или улицам\n\n17) Фильтр по году рождения, городу и улице\n\n18) Поиск по ID в файле отчета с записями фиксированной длины\n\n19) Профиль хранения базы данных\n\n20) Возрастной состав избирателей\n\n21) Назад\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+        if (choice == 21) {
+            cout << "\n\n";
+            return;
+        }
+        if (choice == 6) create_db(table_name);
+        else work_db(choice, table_name);
+#ifdef VOTERS_PROFILE
+        profileReport();
+#endif
+    }
+}
+
+// Поиск или подсчет избирателей сразу по нескольким базам данных (например, по базам районов).
+// Каждая база обрабатывается на отдельном подключении в одном из рабочих потоков.
+void multiDatabaseSearch() {
+    int from = getMenuChoice(u8"\nВыберите базы данных для поиска: \n-------------------------------------------------\n1) Все базы данных в каталоге\n\n2) Перечислить базы данных\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+    vector<string> files;
+    string input;
+    if (from == 1) {
+        do {
+            cout << u8"Введите имя каталога (. - текущий каталог): ";
+            cin.ignore(10000, '\n');
+            getline(cin, input);
+            if (!isValidFilename(input)) {
+                cin.sync();
+                pressEnter();
+                cout << u8"Имя каталога должно содержать только буквы, цифры, подчеркивание или точку!\n";
+            }
+        } while (!isValidFilename(input));
+        files = listDatabases(input);
+    }
+    else if (from == 2) {
+        bool valid;
+        do {
+            cout << u8"Введите имена баз данных через пробел: ";
+            cin.ignore(10000, '\n');
+            getline(cin, input);
+            files = splitCommand(input);
+            valid = !files.empty();
+            for (const auto& name : files) valid = valid && isValidFilename(name);
+            if (!valid) {
+                cin.sync();
+                pressEnter();
+                cout << u8"Имя базы данных должно содержать только буквы, цифры, подчеркивание или точку!\n";
+            }
+        } while (!valid);
+        for (auto& name : files) {
+            if (name.size() < 3 || name.compare(name.size() - 3, 3, ".db") != 0) name += ".db";
+        }
+    }
+    else {
+        cout << u8"Некорректный выбор!" << endl;
+        return;
+    }
+    if (files.empty()) {
+        cout << u8"Базы данных не найдены!" << endl;
+        return;
+    }
+
+    int kind = getMenuChoice(u8"\nВыберите параметр для поиска: \n-------------------------------------------------\n1) Начало фамилии\n\n2) Улица, на которой проживает избиратель\n\n3) Год рождения\n\n4) Город рождения\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+    string where;
+    vector<string> params;
+    string param;
+    switch (kind) {
+    case 1: {
+        do {
+            cout << u8"Введите начало фамилии: ";
+            cin.ignore(10000, '\n');
+            getline(cin, param);
+            if (!isCorrectSecondname(param)) {
+                cin.sync();
+                pressEnter();
+                cout << u8"Начало должно содержать только русские буквы или дефис!\n";
+            }
+        } while (!isCorrectSecondname(param));
+        param = capitalizeFirst(param);
+        string upper = prefixSuccessor(param);
+        where = upper.empty() ? "familiya >= ?" : "familiya >= ? AND familiya < ?";
+        params.push_back(param);
+        if (!upper.empty()) params.push_back(upper);
+        break;
+    }
+    case 2:
+        do {
+            cout << u8"Введите название улицы: ";
+            cin.ignore(10000, '\n');
+            getline(cin, param);
+            if (param.empty()) {
+                cout << u8"Название улицы не может быть пустым!\n";
+            }
+        } while (param.empty());
+        where = "adres LIKE ?";
+        params.push_back("%" + param + "%");
+        break;
+    case 3:
+        do {
+            cout << u8"Введите год рождения: ";
+            cin >> param;
+            if (!isDigitsOnly(param) || param.length() != 4 ||
+                (stoi(param) < 1900 || stoi(param) > 2025)) {
+                cout << u8"Год рождения должен быть четырехзначным числом от 1900 до 2025!\n";
+            }
+        } while (!isDigitsOnly(param) || param.length() != 4 ||
+            (stoi(param) < 1900 || stoi(param) > 2025));
+        where = "godrozh = ?";
+        params.push_back(param);
+        break;
+    case 4:
+        do {
+            cout << u8"Введите город рождения: ";
+            cin.ignore(10000, '\n');
+            getline(cin, param);
+            if (!isRussianLettersOnly(param)) {
+                cout << u8"Город рождения должен содержать только буквы!\n";
+            }
+        } while (!isRussianLettersOnly(param));
+        where = "mesto = ?";
+        params.push_back(param);
+        break;
+    default:
+        cout << u8"Некорректный выбор!" << endl;
+        return;
+    }
+    bool count_only = getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Вывести найденные записи\n\n2) Только подсчитать записи в каждой базе данных\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 2;
+    // Базы подсчитываются параллельно, а записи читаются из них построчно при выводе
+    string count_sql = "SELECT COUNT(*) FROM users WHERE " + where + ";";
+    string sql = "SELECT * FROM users WHERE " + where + " ORDER BY familiya, imya, otchestvo, godrozh, id;";
+
+    vector<SourceResult> sources(files.size());
+    int name_width = 11;
+    for (size_t i = 0; i < files.size(); ++i) {
+        sources[i].file = files[i];
+        size_t slash = files[i].find_last_of("/\\");
+        sources[i].name = files[i].substr(slash == string::npos ? 0 : slash + 1);
+        sources[i].name.resize(sources[i].name.size() - 3);
+        int len = utf8Length(sources[i].name);
+        if (len > name_width) name_width = len;
+    }
+
+    // Базы раздаются рабочим потокам по одной через общий счетчик
+    auto started = chrono::steady_clock::now();
+    size_t workers = thread::hardware_concurrency();
+    if (workers < 2) workers = 2;
+    if (workers > files.size()) workers = files.size();
+    atomic<size_t> next{ 0 };
+    vector<thread> threads;
+    for (size_t w = 0; w < workers; ++w) {
+        threads.emplace_back([&] {
+            PROFILE_SCOPE(ProfileLoader);
+            size_t i;
+            while ((i = next++) < sources.size()) querySource(sources[i], count_sql, params);
+        });
+    }
+    for (auto& t : threads) t.join();
+    double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+
+    long long total = 0;
+    cout << endl << u8"База данных" << padding(name_width, 11) << u8" | Записей    | Время, мс" << endl;
+    for (const auto& source : sources) {
+        cout << source.name << padding(name_width, utf8Length(source.name)) << " | ";
+        if (!source.error.empty()) {
+            cout << u8"ошибка: " << source.error << endl;
+            continue;
+        }
+        cout << left << setw(10) << source.count << " | " << fixed << setprecision(1) << source.ms << endl;
+        total += source.count;
+    }
+    cout << u8"Всего записей: " << total << u8", баз данных: " << sources.size() << u8", потоков: " << workers
+        << u8", общее время: " << elapsed << u8" мс" << endl;
+    cout.unsetf(ios::fixed);
+    if (count_only || total == 0) return;
+
+    {
+        PROFILE_SCOPE(ProfileRender);
+        cout << endl;
+        writeMerged(cout, sources, sql, params, name_width);
+    }
+    if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Записать найденные записи в файл\n\n2) Продолжить без сохранения\n-------------------------------------------------\nВведите цифру подпункта меню: ") != 1) {
+        return;
+    }
+    string filename = "multi_search";
+    if (getMenuChoice(u8"\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Использовать имя файла по умолчанию\n\n2) Задать собственное имя файла для записи\n-------------------------------------------------\nВведите цифру подпункта меню: ") == 2) {
+        do {
+            cout << u8"Введите название файла для записи данных: ";
+            cin.ignore(10000, '\n');
+            getline(cin, filename);
+            if (!isValidFilename(filename)) {
+                cin.sync();
+                pressEnter();
+                cout << u8"Имя файла должно содержать только буквы, цифры, подчеркивание или точку!\n";
+            }
+        } while (!isValidFilename(filename));
+    }
+    filename += ".txt";
+    PROFILE_SCOPE(ProfileExport);
+    string temp = FileBatch::tempName(filename);
+    ofstream file(temp, ios::trunc);
+    if (!file) {
+        cerr << u8"Не удалось открыть файл: " << filename << endl;
+        return;
+    }
+    long long count = writeMerged(file, sources, sql, params, name_width);
+    file.close();
+    if (!file) {
+        cerr << u8"Ошибка записи файла: " << filename << endl;
+        remove(temp.c_str());
+        return;
+    }
+    FileBatch batch;
+    batch.add(filename);
+    if (!batch.commit()) return;
+    cout << u8"\nРезультат сохранен в файл: " << filename << u8" (строк: " << count << ")" << endl;
+}
+
+// Главная функция программы
+// Параметры командной строки:
+//   --serve <база данных> [сокет]              - запуск службы запросов
+//   --loadtest [сокет] [клиенты] [запросы]     - нагрузочный тест службы
+// Пакетный режим и проверка атомарности отчетов вынесены в программу voters_batch.
+int main(int argc, char* argv[]) {
+    initTerminal();
+    const string default_socket = "voters.sock";
+    if (argc > 1 && !initSockets()) {
+        cerr << u8"Не удалось инициализировать сокеты" << endl;
+        return 1;
+    }
+    if (argc > 2 && string(argv[1]) == "--serve") {
+        QueryService service(argv[2]);
+        return service.run(argc > 3 ? argv[3] : default_socket) ? 0 : 1;
+    }
+    if (argc > 1 && string(argv[1]) == "--loadtest") {
+        loadTest(argc > 2 ? argv[2] : default_socket, argc > 3 ? atoi(argv[3]) : 4, argc > 4 ? atoi(argv[4]) : 1000);
+        return 0;
+    }
+    initSockets();
+    cout << u8"\t\t\t\tОзнакомительная практика Рыжов Степан УИБ-111 :)\n" << endl;
+    while (true) {
+        int choice = getMenuChoice(u8"\t\t\t\t\t\tГлавное меню\n\nВыберите функцию для дальнейшей работы: \n-------------------------------------------------\n1) Использовать существующую базу данных\n\n2) Создать новую базу данных\n\n3) Подключиться к службе запросов\n\n4) Поиск по нескольким базам данных\n\n5) Выход из программы\n-------------------------------------------------\nВведите цифру подпункта меню: ");
+        string db_name;
+        switch (choice) {
+        case 1:
+            do {
+                cout << u8"Введите имя базы данных (по умолчанию вводите list_voiters1): ";
+                cin.ignore(10000, '\n');
+                cin.sync();
+                getline(cin, db_name);
+                if (!isValidFilename(db_name)) {
+                    cin.sync();
+                    pressEnter();
+                    cout << u8"Имя базы данных должно содержать только буквы, цифры, подчеркивание или точку!\n";
+                }
+            } while (!isValidFilename(db_name));
+            later_db(db_name + ".db");
+            break;
+        case 2:
+            do {
+                cin.clear();
+                cin.ignore(1000, '\n');
+                cout << u8"Введите имя базы данных для создания: ";
+                getline(cin, db_name);
+                if (!isValidFilename(db_name)) {
+                    cout << u8"Имя базы данных должно содержать только буквы, цифры, подчеркивание или точку!";
+                    cin.sync();
+                    pressEnter();
+                }
+                else {
+                    break;
+                }
+            } while (true);
+            create_db(db_name + ".db");
+            later_db(db_name + ".db");
+            break;
+        case 3:
+            serviceClient(default_socket);
+            break;
+        case 4:
+            multiDatabaseSearch();
+            break;
+        case 5:
+            finishExportJobs();
+            return 0;
+        default:
+            cout << u8"Неверно введенная функция!\n\n";
+            break;
+        }
+    }
+    return 0;
+}
+
+/* Программа разработана студентом группы УИБ-111 Рыжовым Степаном, с использованием базы данных SQL и консольного интерфейса
+Состав программы:
+voters.h, voters.cpp      - ядро (библиотека voters_core): работа с базой данных, проверка ввода, отчеты, индексы
+terminal.h, terminal.cpp  - настройка консоли и имитация нажатия Enter
+sqllitetest.cpp           - интерактивная программа и служба запросов (voters)
+batch.cpp                 - пакетный режим (voters_batch)
+bench.cpp                 - замеры производительности ядра (voters_bench)
+Использованные библиотеки: 
+<iostream>
+<iomanip>
+<fstream>
+<string>
+<vector>
+<algorithm>
+<sstream>
+<cstring>
+<cstdint>
+<cmath>
+<set>
+<map>
+<deque>
+<atomic>
+<unordered_map>
+<thread>
+<mutex>
+<condition_variable>
+<chrono>
+<memory>
+<random>
+<functional>
+<queue>
+<clocale>
+<sqlite3.h> (SQLite)
+<winsock2.h>, <afunix.h> (Windows) или <sys/socket.h>, <sys/un.h>, <unistd.h>
+<Windows.h> (только Windows: консоль, файлы)
+<unistd.h>, <fcntl.h>, <dirent.h>, <sys/wait.h> (Linux и другие POSIX-системы)
+<psapi.h> (Windows, при сборке с VOTERS_PROFILE)
+*/
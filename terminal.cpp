@@ -0,0 +1,29 @@
+#include "terminal.h"
+#include <iostream>
+#include <clocale>
+#include <cstdlib>
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+using namespace std;
+
+void initTerminal() {
+    setlocale(LC_ALL, "ru_RU.UTF-8");
+#ifdef _WIN32
+    SetConsoleCP(CP_UTF8);
+    SetConsoleOutputCP(CP_UTF8);
+    system("chcp 65001 > nul");
+#endif
+}
+
+void pressEnter() {
+#ifdef _WIN32
+    keybd_event(VK_RETURN, 0, 0, 0);
+    keybd_event(VK_RETURN, 0, KEYEVENTF_KEYUP, 0);
+#else
+    // Эмуляции клавиатуры нет - перевод строки возвращается во входной поток
+    cin.clear();
+    cin.putback('\n');
+#endif
+}
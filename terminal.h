@@ -0,0 +1,10 @@
+// Работа с консолью: все обращения к API консоли Windows собраны здесь,
+// чтобы остальной код собирался на любой платформе.
+#pragma once
+
+// Настройка консоли на ввод и вывод в UTF-8
+void initTerminal();
+
+// Имитация нажатия Enter: следующий cin.ignore сразу получает перевод строки
+// и не ждет, пока пользователь нажмет Enter еще раз
+void pressEnter();
@@ -0,0 +1,3202 @@
+#include "voters.h"
+#ifdef _WIN32
+#include <Windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/utime.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utime.h>
+#include <signal.h>
+#include <cerrno>
+#endif
+#if defined(VOTERS_PROFILE) && defined(_WIN32)
+#include <psapi.h>
+#endif
+
+using namespace std;
+
+#ifdef VOTERS_PROFILE
+ProfileCounters profile_counters[ProfileCount];
+
+thread_local int profile_subsystem = ProfileOther;
+
+// Перед каждым блоком хранится заголовок с его размером и подсистемой,
+// чтобы освобождение учитывалось там же, где было выделение
+const size_t profile_header = 16;
+
+void* operator new(size_t size) {
+    char* base = static_cast<char*>(malloc(size + profile_header));
+    if (!base) throw bad_alloc();
+    int subsystem = profile_subsystem;
+    memcpy(base, &size, sizeof(size));
+    memcpy(base + sizeof(size), &subsystem, sizeof(subsystem));
+    ProfileCounters& c = profile_counters[subsystem];
+    ++c.allocations;
+    c.bytes += size;
+    long long live = c.live += size;
+    long long peak = c.peak;
+    while (live > peak && !c.peak.compare_exchange_weak(peak, live)) {}
+    return base + profile_header;
+}
+
+void operator delete(void* ptr) noexcept {
+    if (!ptr) return;
+    char* base = static_cast<char*>(ptr) - profile_header;
+    size_t size;
+    int subsystem;
+    memcpy(&size, base, sizeof(size));
+    memcpy(&subsystem, base + sizeof(size), sizeof(subsystem));
+    profile_counters[subsystem].live -= size;
+    free(base);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* ptr) noexcept { operator delete(ptr); }
+void operator delete(void* ptr, size_t) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { operator delete(ptr); }
+
+long long peakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return static_cast<long long>(counters.PeakWorkingSetSize);
+#else
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return atoll(line.c_str() + 6) * 1024;
+    }
+    return 0;
+#endif
+}
+
+void profileReport() {
+    const char* names[] = { u8"прочее", u8"загрузка", u8"сортировка", u8"вывод", u8"выгрузка" };
+    cout << u8"\n[Память] подсистема  | выделений | выделено, МБ | пик, МБ" << endl;
+    for (int i = 0; i < ProfileCount; ++i) {
+        ProfileCounters& c = profile_counters[i];
+        long long allocations = c.allocations.exchange(0);
+        long long bytes = c.bytes.exchange(0);
+        long long peak = c.peak.exchange(c.live);
+        if (allocations == 0) continue;
+        cout << "  " << left << setw(20) << names[i] << " | " << setw(9) << allocations << " | "
+            << fixed << setprecision(1) << setw(12) << bytes / 1048576.0 << " | " << peak / 1048576.0 << endl;
+    }
+    sqlite3_int64 current = 0, highwater = 0;
+    sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &current, &highwater, 1);
+    cout << u8"  SQLite: занято " << current / 1048576.0 << u8" МБ, пик " << highwater / 1048576.0 << u8" МБ" << endl;
+    cout << u8"  Пиковый RSS процесса: " << peakResidentBytes() / 1048576.0 << u8" МБ" << endl;
+    cout.unsetf(ios::fixed);
+#ifndef _WIN32
+    // Сброс пикового RSS, чтобы следующая сводка показывала пик своего действия
+    ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+#endif
+
+const StorageProfile storage_profiles[storage_profile_count] = {
+    { "standard", u8"стандартный (настройки SQLite по умолчанию)", 0, -2000, 4096, "DEFAULT", "DELETE", "FULL" },
+    { "interactive", u8"интерактивная работа", 64LL << 20, -16384, 4096, "MEMORY", "WAL", "NORMAL" },
+    { "bulk", u8"массовая загрузка", 0, -262144, 4096, "MEMORY", "WAL", "OFF" },
+    { "analytics", u8"аналитика и выгрузки (в основном чтение)", 1LL << 30, -65536, 16384, "MEMORY", "WAL", "NORMAL" },
+};
+
+const StorageProfile& findStorageProfile(const string& name) {
+    for (const auto& p : storage_profiles) {
+        if (name == p.name) return p;
+    }
+    return storage_profiles[0];
+}
+
+string storedProfileName(sqlite3* db) {
+    sqlite3_stmt* stmt = nullptr;
+    string name = storage_profiles[0].name;
+    if (sqlite3_prepare_v2(db, "SELECT value FROM settings WHERE name = 'storage_profile';", -1, &stmt, nullptr) == SQLITE_OK
+        && sqlite3_step(stmt) == SQLITE_ROW) {
+        name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    return name;
+}
+
+bool applyStorageProfile(sqlite3* db, const StorageProfile& p, bool change_page_size) {
+    string sql = "PRAGMA mmap_size = " + to_string(p.mmap_size) + ";"
+        "PRAGMA cache_size = " + to_string(p.cache_size) + ";"
+        "PRAGMA temp_store = " + p.temp_store + ";";
+    if (change_page_size) {
+        sql += "PRAGMA journal_mode = DELETE;"
+            "PRAGMA page_size = " + to_string(p.page_size) + ";"
+            "VACUUM;";
+    }
+    // Режим журнала и уровень синхронизации нельзя сменить внутри транзакции
+    // (например, в пакетном режиме)
+    if (sqlite3_get_autocommit(db)) {
+        sql += string("PRAGMA journal_mode = ") + p.journal_mode + ";"
+            "PRAGMA synchronous = " + p.synchronous + ";";
+    }
+    char* error = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &error) != SQLITE_OK) {
+        cerr << u8"Ошибка применения профиля хранения: " << (error ? error : "") << endl;
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+bool walMode(sqlite3* db) {
+    SQLiteStmt stmt(db, "PRAGMA journal_mode;");
+    return sqlite3_step(stmt.get()) == SQLITE_ROW && columnText(stmt.get(), 0) == "wal";
+}
+
+SQLiteDB::SQLiteDB(const string& name) {
+    if (sqlite3_open(name.c_str(), &db) != SQLITE_OK) {
+        cerr << u8"Ошибка SQLite: " << sqlite3_errmsg(db) << endl;
+        exit(1);
+    }
+    // База может быть занята фоновой выгрузкой или службой запросов - ждем, а не завершаемся ошибкой
+    sqlite3_busy_timeout(db, 5000);
+    applyStorageProfile(db, findStorageProfile(storedProfileName(db)), false);
+}
+
+SQLiteStmt::SQLiteStmt(sqlite3* db, const string& sql) {
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        cerr << u8"Ошибка SQLite: " << sqlite3_errmsg(db) << endl;
+        exit(1);
+    }
+}
+
+bool isRussianLettersOnly(const string& str) {
+    if (str.empty()) return false;
+    for (int i = 0; i < str.length(); ) {
+        unsigned char c = str[i];
+        if (c == ' ') {
+            i++;
+            continue;
+        }
+        if (i + 1 >= str.length()) return false; 
+        unsigned char next = str[i + 1];
+
+        if (c == 0xD0 && ((next >= 0x90 && next <= 0xBF) || next == 0x81)) {
+            i += 2; 
+        }
+        else if (c == 0xD1 && ((next >= 0x80 && next <= 0x8F) || next == 0x91)) {
+            i += 2; 
+        }
+        else {
+            return false; 
+        }
+    }
+    return true;
+}
+
+bool firstTrue(const string& str) {
+    unsigned char byte1 = static_cast<unsigned char>(str[0]);
+    unsigned char byte2 = (str.size() > 1) ? static_cast<unsigned char>(str[1]) : 0;
+
+    bool firstCharValid = false;
+    if (byte1 == 0xD0) {
+        // Проверяем А-Я (кроме Ё)
+        if (byte2 >= 0x90 && byte2 <= 0xAF) {
+            firstCharValid = true;
+        }
+        // Проверяем Ё отдельно
+        else if (byte2 == 0x81) {
+            firstCharValid = true;
+        }
+    }
+    if (!firstCharValid) {
+        return false;
+    }
+    return true;
+}
+
+bool isCorrectSecondname(const string& str) {
+    if (str.empty()) return false;
+    for (int i = 0; i < str.length(); ) {
+        unsigned char c = str[i];
+        // Дефис разрешён, но не в начале и не в конце
+        if (c == 0x2D) {
+            if (i == 0 || i == str.length() - 1) {  // Дефис в начале или конце — ошибка
+                return false;
+            }
+            i++;  // Переходим к следующему символу
+            continue;
+        }
+        if (i + 1 >= str.length()) return false;
+        unsigned char next = str[i + 1];
+
+        if (c == 0xD0 && ((next >= 0x90 && next <= 0xBF) || next == 0x81)) {
+            i += 2;
+        }
+        else if (c == 0xD1 && ((next >= 0x80 && next <= 0x8F) || next == 0x91)) {
+            i += 2;
+        }
+        else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isDigitsOnly(const string& str) {
+    for (char c : str) {
+        if (!isdigit(c)) {
+            return false;
+        }
+    }
+    return !str.empty();
+}
+
+bool isValidFilename(const string& str) {
+    if (str.empty()) return false;
+    for (int i = 0; i < str.length(); ) {
+        unsigned char c = str[i];
+        if (c == 0x2E) {
+            i += 1;
+        }
+        else if (c == 0x5F) {
+            i += 1;
+        }
+        else if (c >= 0x30 && c <= 0x39) {
+            i += 1;
+        }
+        else if ((c >= 0x41 && c <= 0x5A) || (c >= 0x61 && c <= 0x7A)) {
+            i += 1;
+        }
+        else if (i + 1 < str.length()) { 
+            unsigned char next = str[i + 1];
+            if (c == 0xD0 && ((next >= 0x90 && next <= 0xBF) || next == 0x81)) {
+                i += 2; 
+            }
+            else if (c == 0xD1 && ((next >= 0x80 && next <= 0x8F) || next == 0x91)) {
+                i += 2; 
+            }
+            else {
+                return false; 
+            }
+        }
+        else {
+            return false; 
+        }
+    }
+    return true;
+}
+
+bool normalizeAddress(const string& raw, string& adres) {
+    string ulitsa;
+    int dom = 0, kv = 0;
+    istringstream iss(raw);
+    iss >> ulitsa >> dom >> kv;
+    if (kv == 0 && dom == 0) return false;
+    adres = u8"Ул. " + ulitsa + u8", д. " + to_string(dom) + u8", кв. " + to_string(kv);
+    return true;
+}
+
+void printTableHeader(ostream& out) {
+    out << left << setw(2) << u8"ID" << " | " << left << setw(27) << u8"Фамилия" << " | "
+        << left << setw(13) << u8"Имя" << " | " << left << setw(23) << u8"Отчество" << " | "
+        << left << setw(10) << u8"Год рождения" << " | " << left << setw(33) << u8"Адрес" << " | "
+        << left << setw(15) << u8"Место" << endl;
+    out << u8"--------------------------------------------------------------------------------------------------------------------------" << endl;
+}
+
+string padding(int width, int len) {
+    return string(len < width ? width - len : 0, ' ');
+}
+
+void printRow(ostream& out, int id, const string& familiya, const string& imya, const string& otchestvo, int godrozh, const string& adres, const string& mesto) {
+    int lenFamiliya = 0;
+    if (familiya != "") {
+        const unsigned char* ptr = reinterpret_cast<const unsigned char*>(familiya.c_str());
+        while (*ptr) {
+            if ((*ptr & 0xC0) != 0x80) lenFamiliya++;
+            ptr++;
+        }
+    }
+
+    int lenImya = 0;
+    if (imya != "") {
+        const unsigned char* ptr = reinterpret_cast<const unsigned char*>(imya.c_str());
+        while (*ptr) {
+            if ((*ptr & 0xC0) != 0x80) lenImya++;
+            ptr++;
+        }
+    }
+
+    int lenOtchestvo = 0;
+    if (otchestvo != "") {
+        const unsigned char* ptr = reinterpret_cast<const unsigned char*>(otchestvo.c_str());
+        while (*ptr) {
+            if ((*ptr & 0xC0) != 0x80) lenOtchestvo++;
+            ptr++;
+        }
+    }
+
+    int lenAdres = 0;
+    if (adres != "") {
+        const unsigned char* ptr = reinterpret_cast<const unsigned char*>(adres.c_str());
+        while (*ptr) {
+            if ((*ptr & 0xC0) != 0x80) lenAdres++;
+            ptr++;
+        }
+    }
+
+    int lenMesto = 0;
+    if (mesto != "") {
+        const unsigned char* ptr = reinterpret_cast<const unsigned char*>(mesto.c_str());
+        while (*ptr) {
+            if ((*ptr & 0xC0) != 0x80) lenMesto++;
+            ptr++;
+        }
+    }
+
+    // Длина года рождения в символах
+    int lenGodrozh = to_string(godrozh).length();
+    out << left << setw(2) << id << " | " << familiya << padding(20, lenFamiliya) << " | "
+        << imya << padding(10, lenImya) << " | " << otchestvo << padding(15, lenOtchestvo) << " | "
+        << left << setw(12) << godrozh << " | " << adres << padding(28, lenAdres) << " | "
+        << mesto << padding(15, lenMesto) << endl;
+}
+
+string trim(const string& str) {
+    int first = str.find_first_not_of(' ');
+    if (first == string::npos) return ""; // Если строка состоит только из пробелов
+    int last = str.find_last_not_of(' ');
+    return str.substr(first, last - first + 1);
+}
+
+bool parseUserLine(const string& line, User& u) {
+    size_t bounds[8];
+    bounds[0] = 0;
+    size_t pos = 0;
+    for (int i = 1; i < 7; ++i) {
+        pos = line.find('|', pos);
+        if (pos == string::npos) return false;
+        bounds[i] = ++pos;
+    }
+    bounds[7] = line.size() + 1;
+    auto field = [&](int i) { return trim(line.substr(bounds[i], bounds[i + 1] - 1 - bounds[i])); };
+    try {
+        u.id = stoi(field(0));
+        u.godrozh = stoi(field(4));
+    }
+    catch (const exception&) {
+        return false;
+    }
+    u.familiya = field(1);
+    u.imya = field(2);
+    u.otchestvo = field(3);
+    u.adres = field(5);
+    u.mesto = field(6);
+    return true;
+}
+
+bool isHeaderLine(const string& line) {
+    return line.empty() || line.find("ID") != string::npos || line.find("---") != string::npos;
+}
+
+const string sort_columns[] = { "familiya", "imya", "otchestvo", "godrozh", "adres", "mesto" };
+
+ReportPipeline& ReportPipeline::filter(Predicate predicate) {
+    stages.push_back({ move(predicate), nullptr });
+    return *this;
+}
+
+ReportPipeline& ReportPipeline::map(Transform transform) {
+    stages.push_back({ nullptr, move(transform) });
+    return *this;
+}
+
+long long ReportPipeline::run(const Sink& sink) const {
+    vector<char> buffer(1 << 20);
+    ifstream file;
+    file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    file.open(filename, ios::binary);
+    if (!file) return -1;
+    long long passed = 0;
+    string line;
+    User u;
+    while (getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (isHeaderLine(line)) continue;
+        if (!parseUserLine(line, u)) {
+            cerr << u8"Ошибка парсинга строки: " << line << endl;
+            continue;
+        }
+        bool keep = true;
+        for (const auto& stage : stages) {
+            if (stage.first) keep = stage.first(u);
+            else stage.second(u);
+            if (!keep) break;
+        }
+        if (!keep) continue;
+        sink(u);
+        ++passed;
+    }
+    return passed;
+}
+
+string orderByClause(const vector<SortKey>& keys) {
+    string clause;
+    for (const auto& k : keys) {
+        clause += sort_columns[k.field] + (k.ascending ? " ASC, " : " DESC, ");
+    }
+    return clause + "id ASC";
+}
+
+string encodeSortKey(const User& u, const vector<SortKey>& keys) {
+    string key;
+    for (const auto& k : keys) {
+        size_t start = key.size();
+        if (k.field == 3) {
+            uint32_t v = static_cast<uint32_t>(u.godrozh) ^ 0x80000000u;
+            key.push_back(static_cast<char>(v >> 24));
+            key.push_back(static_cast<char>(v >> 16));
+            key.push_back(static_cast<char>(v >> 8));
+            key.push_back(static_cast<char>(v));
+        }
+        else {
+            const string& text = k.field == 0 ? u.familiya : k.field == 1 ? u.imya : k.field == 2 ? u.otchestvo
+                : k.field == 4 ? u.adres : u.mesto;
+            key += text;
+            key.push_back('\0');
+        }
+        if (!k.ascending) {
+            for (size_t i = start; i < key.size(); ++i) key[i] = static_cast<char>(~key[i]);
+        }
+    }
+    return key;
+}
+
+bool sortKeyLess(const string& a, const string& b) {
+    size_t n = a.size() < b.size() ? a.size() : b.size();
+    int r = memcmp(a.data(), b.data(), n);
+    return r != 0 ? r < 0 : a.size() < b.size();
+}
+
+void sortUsers(vector<User>& users, const vector<SortKey>& keys) {
+    PROFILE_SCOPE(ProfileSort);
+    vector<pair<string, size_t>> order;
+    order.reserve(users.size());
+    for (size_t i = 0; i < users.size(); ++i) {
+        order.push_back({ encodeSortKey(users[i], keys), i });
+    }
+    stable_sort(order.begin(), order.end(), [](const pair<string, size_t>& a, const pair<string, size_t>& b) {
+        return sortKeyLess(a.first, b.first);
+        });
+    vector<User> sorted;
+    sorted.reserve(users.size());
+    for (const auto& o : order) {
+        sorted.push_back(move(users[o.second]));
+    }
+    users.swap(sorted);
+}
+
+vector<SortKey> parseOrderBy(const string& clause) {
+    vector<SortKey> keys;
+    stringstream ss(clause);
+    string part;
+    while (getline(ss, part, ',')) {
+        stringstream ps(part);
+        string column, direction;
+        ps >> column >> direction;
+        for (int i = 0; i < 6; ++i) {
+            if (sort_columns[i] == column) keys.push_back({ i, direction != "DESC" });
+        }
+    }
+    return keys;
+}
+
+string encodeReportKey(const User& u, const vector<SortKey>& keys) {
+    string key = encodeSortKey(u, keys);
+    uint32_t id = static_cast<uint32_t>(u.id);
+    key.push_back(static_cast<char>(id >> 24));
+    key.push_back(static_cast<char>(id >> 16));
+    key.push_back(static_cast<char>(id >> 8));
+    key.push_back(static_cast<char>(id));
+    return key;
+}
+
+bool ensureJournal(sqlite3* db) {
+    const char* journalSQL =
+        "CREATE TABLE IF NOT EXISTS changes ("
+        "seq INTEGER PRIMARY KEY AUTOINCREMENT, op TEXT NOT NULL, user_id INTEGER NOT NULL, "
+        "familiya TEXT, imya TEXT, otchestvo TEXT, godrozh INTEGER, adres TEXT, mesto TEXT);"
+        "CREATE TABLE IF NOT EXISTS reports ("
+        "filename TEXT PRIMARY KEY, kind TEXT NOT NULL, param TEXT NOT NULL, position INTEGER NOT NULL, "
+        "size INTEGER NOT NULL DEFAULT -1, mtime INTEGER NOT NULL DEFAULT -1);"
+        "CREATE TABLE IF NOT EXISTS stats ("
+        "name TEXT PRIMARY KEY, position INTEGER NOT NULL, data BLOB NOT NULL);"
+        "CREATE TRIGGER IF NOT EXISTS users_journal_insert AFTER INSERT ON users BEGIN "
+        "INSERT INTO changes (op, user_id, familiya, imya, otchestvo, godrozh, adres, mesto) "
+        "VALUES ('I', NEW.id, NEW.familiya, NEW.imya, NEW.otchestvo, NEW.godrozh, NEW.adres, NEW.mesto); END;"
+        "CREATE TRIGGER IF NOT EXISTS users_journal_delete AFTER DELETE ON users BEGIN "
+        "INSERT INTO changes (op, user_id, familiya, imya, otchestvo, godrozh, adres, mesto) "
+        "VALUES ('D', OLD.id, OLD.familiya, OLD.imya, OLD.otchestvo, OLD.godrozh, OLD.adres, OLD.mesto); END;"
+        "CREATE TRIGGER IF NOT EXISTS users_journal_update AFTER UPDATE ON users BEGIN "
+        "INSERT INTO changes (op, user_id, familiya, imya, otchestvo, godrozh, adres, mesto) "
+        "VALUES ('D', OLD.id, OLD.familiya, OLD.imya, OLD.otchestvo, OLD.godrozh, OLD.adres, OLD.mesto); "
+        "INSERT INTO changes (op, user_id, familiya, imya, otchestvo, godrozh, adres, mesto) "
+        "VALUES ('I', NEW.id, NEW.familiya, NEW.imya, NEW.otchestvo, NEW.godrozh, NEW.adres, NEW.mesto); END;";
+    if (sqlite3_exec(db, journalSQL, nullptr, nullptr, nullptr) != SQLITE_OK) {
+        cerr << u8"Ошибка создания журнала изменений: " << sqlite3_errmsg(db) << endl;
+        return false;
+    }
+    // Базы прежних версий: в таблице reports нет отметки файла
+    sqlite3_stmt* probe = nullptr;
+    bool stamped = sqlite3_prepare_v2(db, "SELECT size, mtime FROM reports;", -1, &probe, nullptr) == SQLITE_OK;
+    sqlite3_finalize(probe);
+    if (!stamped && sqlite3_exec(db, "ALTER TABLE reports ADD COLUMN size INTEGER NOT NULL DEFAULT -1;"
+        "ALTER TABLE reports ADD COLUMN mtime INTEGER NOT NULL DEFAULT -1;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        cerr << u8"Ошибка обновления таблицы отчетов: " << sqlite3_errmsg(db) << endl;
+        return false;
+    }
+    clearStaleHolds(db);
+    return true;
+}
+
+bool ensureIndexes(sqlite3* db) {
+    const char* indexSQL =
+        "CREATE INDEX IF NOT EXISTS users_familiya ON users (familiya);"
+        "CREATE INDEX IF NOT EXISTS users_imya ON users (imya);";
+    if (sqlite3_exec(db, indexSQL, nullptr, nullptr, nullptr) != SQLITE_OK) {
+        cerr << u8"Ошибка создания индексов: " << sqlite3_errmsg(db) << endl;
+        return false;
+    }
+    return true;
+}
+
+long long journalPosition(sqlite3* db) {
+    SQLiteStmt stmt(db, "SELECT seq FROM sqlite_sequence WHERE name = 'changes';");
+    return sqlite3_step(stmt.get()) == SQLITE_ROW ? sqlite3_column_int64(stmt.get(), 0) : 0;
+}
+
+void clearStaleHolds(sqlite3* db) {
+    vector<string> stale;
+    {
+        SQLiteStmt stmt(db, "SELECT name FROM stats WHERE name LIKE 'export:%';");
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+            string name = columnText(stmt.get(), 0);
+            size_t colon = name.find(':', 7);
+            string pid = name.substr(7, colon == string::npos ? string::npos : colon - 7);
+            // Записи прежнего вида "export:<файл>" без номера процесса тоже устарели
+            if (colon == string::npos || !isDigitsOnly(pid) || !processAlive(stoll(pid))) stale.push_back(name);
+        }
+    }
+    for (const auto& name : stale) {
+        SQLiteStmt release(db, "DELETE FROM stats WHERE name = ?;");
+        sqlite3_bind_text(release.get(), 1, name.c_str(), -1, SQLITE_STATIC);
+        sqlite3_step(release.get());
+    }
+}
+
+// Индекс в памяти -> база данных и позиция журнала
+map<string, pair<string, long long>> memory_holds;
+mutex memory_holds_mutex;
+
+void holdJournalInMemory(const string& owner, const string& db_name, long long position) {
+    lock_guard<mutex> lock(memory_holds_mutex);
+    memory_holds[owner] = { db_name, position };
+}
+
+void pruneJournal(sqlite3* db) {
+    string db_name = sqlite3_db_filename(db, "main") ? sqlite3_db_filename(db, "main") : "";
+    long long limit = 0x7FFFFFFFFFFFFFFFll;
+    {
+        lock_guard<mutex> lock(memory_holds_mutex);
+        for (const auto& h : memory_holds) {
+            if (h.second.first == db_name && h.second.second < limit) limit = h.second.second;
+        }
+    }
+    SQLiteStmt stmt(db, "DELETE FROM changes WHERE seq <= ? AND seq <= COALESCE("
+        "(SELECT MIN(position) FROM (SELECT position FROM reports UNION ALL SELECT position FROM stats)), "
+        "(SELECT seq FROM sqlite_sequence WHERE name = 'changes'));");
+    sqlite3_bind_int64(stmt.get(), 1, limit);
+    sqlite3_step(stmt.get());
+}
+
+bool replayJournal(sqlite3* db, long long& position, const function<void(const User&, bool)>& apply) {
+    SQLiteStmt changes(db, "SELECT seq, op, user_id, familiya, imya, otchestvo, godrozh, adres, mesto "
+        "FROM changes WHERE seq > ? ORDER BY seq;");
+    sqlite3_bind_int64(changes.get(), 1, position);
+    bool first = true;
+    while (sqlite3_step(changes.get()) == SQLITE_ROW) {
+        long long seq = sqlite3_column_int64(changes.get(), 0);
+        // Номера изменений идут подряд, очищается только начало журнала
+        if (first && seq != position + 1) return false;
+        first = false;
+        position = seq;
+        User u;
+        u.id = sqlite3_column_int(changes.get(), 2);
+        readUserColumns(changes.get(), 3, u);
+        apply(u, columnText(changes.get(), 1) == "I");
+    }
+    return !first || journalPosition(db) == position;
+}
+
+string columnText(sqlite3_stmt* stmt, int col) {
+    const unsigned char* text = sqlite3_column_text(stmt, col);
+    return text ? reinterpret_cast<const char*>(text) : "";
+}
+
+void readUserColumns(sqlite3_stmt* stmt, int first, User& u) {
+    u.familiya = columnText(stmt, first);
+    u.imya = columnText(stmt, first + 1);
+    u.otchestvo = columnText(stmt, first + 2);
+    u.godrozh = sqlite3_column_int(stmt, first + 3);
+    u.adres = columnText(stmt, first + 4);
+    u.mesto = columnText(stmt, first + 5);
+}
+
+int crash_countdown = 0;
+
+void crashPoint() {
+    if (crash_countdown > 0 && --crash_countdown == 0) _Exit(3);
+}
+
+string directoryOf(const string& filename) {
+    size_t slash = filename.find_last_of("/\\");
+    return slash == string::npos ? "." : filename.substr(0, slash);
+}
+
+bool syncFiles(const vector<string>& names) {
+    bool ok = true;
+#ifdef _WIN32
+    for (const auto& name : names) {
+        HANDLE h = CreateFileA(name.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (h == INVALID_HANDLE_VALUE || !FlushFileBuffers(h)) ok = false;
+        if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
+    }
+#elif defined(__linux__)
+    set<string> dirs;
+    for (const auto& name : names) {
+        if (!dirs.insert(directoryOf(name)).second) continue;
+        int fd = open(name.c_str(), O_RDONLY);
+        if (fd < 0 || syncfs(fd) != 0) ok = false;
+        if (fd >= 0) close(fd);
+    }
+#else
+    for (const auto& name : names) {
+        int fd = open(name.c_str(), O_RDONLY);
+        if (fd < 0 || fsync(fd) != 0) ok = false;
+        if (fd >= 0) close(fd);
+    }
+#endif
+    return ok;
+}
+
+bool replaceFile(const string& temp, const string& target) {
+#ifdef _WIN32
+    return MoveFileExA(temp.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(temp.c_str(), target.c_str()) == 0;
+#endif
+}
+
+long long currentProcessId() {
+#ifdef _WIN32
+    return static_cast<long long>(GetCurrentProcessId());
+#else
+    return static_cast<long long>(getpid());
+#endif
+}
+
+bool processAlive(long long pid) {
+#ifdef _WIN32
+    HANDLE h = OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(pid));
+    if (!h) return GetLastError() == ERROR_ACCESS_DENIED;
+    bool alive = WaitForSingleObject(h, 0) == WAIT_TIMEOUT;
+    CloseHandle(h);
+    return alive;
+#else
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+string absolutePath(const string& filename) {
+#ifdef _WIN32
+    char buffer[MAX_PATH];
+    DWORD n = GetFullPathNameA(filename.c_str(), MAX_PATH, buffer, nullptr);
+    return n > 0 && n < MAX_PATH ? string(buffer, n) : filename;
+#else
+    if (!filename.empty() && filename[0] == '/') return filename;
+    char buffer[4096];
+    return getcwd(buffer, sizeof(buffer)) ? string(buffer) + "/" + filename : filename;
+#endif
+}
+
+bool fileStamp(const string& filename, long long& size, long long& mtime) {
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(filename.c_str(), &st) != 0) return false;
+#else
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) return false;
+#endif
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+}
+
+void setFileTime(const string& filename, long long mtime) {
+#ifdef _WIN32
+    struct __utimbuf64 times = { mtime, mtime };
+    _utime64(filename.c_str(), &times);
+#else
+    struct utimbuf times;
+    times.actime = times.modtime = static_cast<time_t>(mtime);
+    utime(filename.c_str(), &times);
+#endif
+}
+
+bool truncateFile(const string& filename, long long size) {
+#ifdef _WIN32
+    HANDLE h = CreateFileA(filename.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER offset;
+    offset.QuadPart = size;
+    bool ok = SetFilePointerEx(h, offset, nullptr, FILE_BEGIN) && SetEndOfFile(h);
+    CloseHandle(h);
+    return ok;
+#else
+    return truncate(filename.c_str(), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+FileUndo* file_undo = nullptr;
+
+void FileUndo::save(const string& target) {
+    if (saved.count(target)) return;
+    ifstream original(target, ios::binary);
+    bool existed = static_cast<bool>(original);
+    if (existed) {
+        {
+            ofstream backup(backupName(target), ios::binary | ios::trunc);
+            backup << original.rdbuf();
+        }
+        // Восстановленный файл должен совпасть с отметкой в таблице reports
+        long long size, mtime;
+        if (fileStamp(target, size, mtime)) setFileTime(backupName(target), mtime);
+    }
+    saved[target] = existed;
+}
+
+void FileUndo::commit() {
+    for (const auto& f : saved) {
+        if (f.second) remove(backupName(f.first).c_str());
+    }
+    saved.clear();
+}
+
+void FileUndo::rollback() {
+    for (const auto& f : saved) {
+        if (f.second) replaceFile(backupName(f.first), f.first);
+        else remove(f.first.c_str());
+    }
+    saved.clear();
+}
+
+void beforeFileChange(const string& target) {
+    if (file_undo) file_undo->save(target);
+}
+
+bool FileBatch::commit() {
+    if (files.empty()) return true;
+    vector<string> temps;
+    for (const auto& f : files) temps.push_back(f.first);
+    crashPoint();
+    if (!syncFiles(temps)) {
+        cerr << u8"Не удалось сбросить файлы на диск" << endl;
+        discard();
+        return false;
+    }
+    bool ok = true;
+    for (const auto& f : files) {
+        crashPoint();
+        beforeFileChange(f.second);
+        if (!replaceFile(f.first, f.second)) {
+            cerr << u8"Не удалось заменить файл: " << f.second << endl;
+            remove(f.first.c_str());
+            ok = false;
+        }
+    }
+#ifndef _WIN32
+    // Переименования становятся долговечными после сброса каталога
+    set<string> dirs;
+    for (const auto& f : files) dirs.insert(directoryOf(f.second));
+    for (const auto& dir : dirs) {
+        int fd = open(dir.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            fsync(fd);
+            close(fd);
+        }
+    }
+#endif
+    files.clear();
+    crashPoint();
+    return ok;
+}
+
+void FileBatch::discard() {
+    for (const auto& f : files) remove(f.first.c_str());
+    files.clear();
+}
+
+ResultCursor::~ResultCursor() {
+    if (spill) fclose(spill);
+}
+
+bool ResultCursor::empty() {
+    if (!started) fetch();
+    return spilled == 0 && ring.empty();
+}
+
+bool ResultCursor::fetch() {
+    if (!step()) return false;
+    store();
+    return true;
+}
+
+bool ResultCursor::step() {
+    if (done) return false;
+    int rc;
+    if (!started) {
+        // Позиция журнала читается в одной транзакции с первой строкой: после
+        // COMMIT запрос дочитывает тот же снимок, поэтому изменения, внесенные
+        // позже, отчет получит из журнала
+        sqlite3* db = sqlite3_db_handle(stmt);
+        bool own = sqlite3_get_autocommit(db) != 0;
+        if (own) sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+        snapshot = journalPosition(db);
+        rc = sqlite3_step(stmt);
+        if (own) sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+        started = true;
+    }
+    else {
+        rc = sqlite3_step(stmt);
+    }
+    if (rc != SQLITE_ROW) {
+        done = true;
+        if (rc != SQLITE_DONE) {
+            cerr << u8"Ошибка выполнения запроса: " << sqlite3_errmsg(sqlite3_db_handle(stmt)) << endl;
+            error = true;
+        }
+        return false;
+    }
+    return true;
+}
+
+void ResultCursor::store() {
+    if (ring.size() >= capacity) {
+        if (replayable) spillRow(ring.front());
+        else lost = true;
+        ring.pop_front();
+    }
+    User u;
+    u.id = sqlite3_column_int(stmt, 0);
+    readUserColumns(stmt, 1, u);
+    ring.push_back(move(u));
+}
+
+void ResultCursor::restart() {
+    sqlite3_reset(stmt);
+    ring.clear();
+    started = done = error = lost = false;
+}
+
+void ResultCursor::spillRow(const User& u) {
+    if (!spill) spill = tmpfile();
+    if (!spill) {
+        // Без временного файла повторный обход выполнит запрос заново
+        replayable = false;
+        lost = true;
+        return;
+    }
+    if (!spill_at_end) {
+        fseek(spill, 0, SEEK_END);
+        spill_at_end = true;
+    }
+    int32_t numbers[2] = { u.id, u.godrozh };
+    fwrite(numbers, sizeof(numbers), 1, spill);
+    for (const string* field : { &u.familiya, &u.imya, &u.otchestvo, &u.adres, &u.mesto }) {
+        uint32_t len = static_cast<uint32_t>(field->size());
+        fwrite(&len, sizeof(len), 1, spill);
+        fwrite(field->data(), 1, len, spill);
+    }
+    ++spilled;
+}
+
+bool ResultCursor::readSpilled(User& u) {
+    int32_t numbers[2];
+    if (fread(numbers, sizeof(numbers), 1, spill) != 1) return false;
+    u.id = numbers[0];
+    u.godrozh = numbers[1];
+    for (string* field : { &u.familiya, &u.imya, &u.otchestvo, &u.adres, &u.mesto }) {
+        uint32_t len = 0;
+        if (fread(&len, sizeof(len), 1, spill) != 1) return false;
+        field->resize(len);
+        if (len > 0 && fread(&(*field)[0], 1, len, spill) != len) return false;
+    }
+    return true;
+}
+
+int utf8Length(const string& text) {
+    int len = 0;
+    for (unsigned char c : text) {
+        if ((c & 0xC0) != 0x80) len++;
+    }
+    return len;
+}
+
+void print(ResultCursor& rows) {
+    PROFILE_SCOPE(ProfileRender);
+    // Заголовок с шириной столбцов (в символах)
+    cout << left << setw(2) << u8"ID" << " | "
+        << left << setw(25) << u8"Фамилия" << " | "
+        << left << setw(13) << u8"Имя" << " | "
+        << left << setw(23) << u8"Отчество" << " | "
+        << left << setw(12) << u8"Год рождения" << " | "
+        << left << setw(35) << u8"Адрес" << " | "
+        << left << setw(15) << u8"Место" << endl;
+    cout << u8"------------------------------------------------------------------------------------------------------------------------" << endl;
+    rows.forEach([](const User& u) {
+        // Длина года рождения в символах
+        int lenGodrozh = to_string(u.godrozh).length();
+
+        // Вывод с учётом ширины столбцов
+        cout << left << setw(2) << u.id << " | "
+            << u.familiya << padding(18, utf8Length(u.familiya)) << " | "
+            << u.imya << padding(10, utf8Length(u.imya)) << " | "
+            << u.otchestvo << padding(15, utf8Length(u.otchestvo)) << " | "
+            << u.godrozh << padding(12, lenGodrozh) << " | "
+            << u.adres << padding(30, utf8Length(u.adres)) << " | "
+            << u.mesto << padding(15, utf8Length(u.mesto)) << endl;
+        return true;
+        });
+}
+
+bool write(const string& f_name, ResultCursor& rows, bool append) {
+    PROFILE_SCOPE(ProfileExport);
+    // Новый файл пишется во временный и заменяет старый целиком
+    string target = append ? f_name : FileBatch::tempName(f_name);
+    if (append) beforeFileChange(f_name);
+    ofstream file(target, append ? ios::app : ios::out);
+    if (!file) {
+        cerr << u8"Не удалось открыть файл: " << f_name << endl;
+        return false;
+    }
+    if (!append) printTableHeader(file);
+    rows.forEach([&](const User& u) {
+        printRow(file, u.id, u.familiya, u.imya, u.otchestvo, u.godrozh, u.adres, u.mesto);
+        return true;
+        });
+    crashPoint();
+    file.close();
+    if (!file) {
+        cerr << u8"Ошибка записи файла: " << f_name << endl;
+        if (!append) remove(target.c_str());
+        return false;
+    }
+    if (!append) {
+        FileBatch batch;
+        batch.add(f_name);
+        if (!batch.commit()) return false;
+    }
+    cout << u8"\nРезультат сохранен в файл: " << f_name;
+    return true;
+}
+
+void putFixed(string& out, const string& value, int width) {
+    size_t len = value.size();
+    if (len > static_cast<size_t>(width)) {
+        len = width;
+        while (len > 0 && (static_cast<unsigned char>(value[len]) & 0xC0) == 0x80) --len;
+    }
+    out.append(value, 0, len);
+    out.append(width - len, ' ');
+}
+
+string fixedLine(const string (&fields)[fixed_fields]) {
+    string line;
+    line.reserve(static_cast<size_t>(fixed_record_size));
+    for (int i = 0; i < fixed_fields; ++i) {
+        if (i > 0) line += " | ";
+        putFixed(line, fields[i], fixed_widths[i]);
+    }
+    line += '\n';
+    return line;
+}
+
+string formatFixedRecord(const User& u, bool removed) {
+    string id = to_string(u.id);
+    const string fields[fixed_fields] = { removed ? "x" : " ", string(10 - id.size(), ' ') + id,
+        u.familiya, u.imya, u.otchestvo, to_string(u.godrozh), u.adres, u.mesto };
+    return fixedLine(fields);
+}
+
+bool parseFixedRecord(const string& record, User& u, bool& removed) {
+    if (record.size() != static_cast<size_t>(fixed_record_size) || record.back() != '\n') return false;
+    string fields[fixed_fields];
+    size_t pos = 0;
+    for (int i = 0; i < fixed_fields; ++i) {
+        fields[i] = record.substr(pos, fixed_widths[i]);
+        size_t end = fields[i].find_last_not_of(' ');
+        fields[i].erase(end == string::npos ? 0 : end + 1);
+        pos += fixed_widths[i] + 3;
+    }
+    try {
+        removed = fields[0] == "x";
+        u.id = stoi(fields[1]);
+        u.familiya = fields[2];
+        u.imya = fields[3];
+        u.otchestvo = fields[4];
+        u.godrozh = stoi(fields[5]);
+        u.adres = fields[6];
+        u.mesto = fields[7];
+    }
+    catch (const exception&) {
+        return false;
+    }
+    return true;
+}
+
+bool FixedReport::readRecord(long long index, string& record) {
+    record.resize(static_cast<size_t>(fixed_record_size));
+    file.clear();
+    file.seekg((index + 2) * fixed_record_size);
+    return static_cast<bool>(file.read(&record[0], fixed_record_size));
+}
+
+bool FixedReport::writeRecord(long long index, const string& record) {
+    file.clear();
+    file.seekp((index + 2) * fixed_record_size);
+    return static_cast<bool>(file.write(record.data(), record.size()));
+}
+
+bool FixedReport::create(const string& filename) {
+    if (file.is_open()) file.close();
+    file.clear();
+    file.open(filename, ios::in | ios::out | ios::binary | ios::trunc);
+    if (!file) return false;
+    records = removed = 0;
+    const string captions[fixed_fields] = { " ", "ID", u8"Фамилия", u8"Имя", u8"Отчество", u8"Год", u8"Адрес", u8"Место" };
+    string caption = fixedLine(captions);
+    file.seekp(fixed_record_size);
+    file.write(caption.data(), caption.size());
+    return writeHeader();
+}
+
+bool FixedReport::open(const string& filename) {
+    file.open(filename, ios::in | ios::out | ios::binary);
+    if (!file) return false;
+    string header(static_cast<size_t>(fixed_record_size), ' ');
+    if (!file.read(&header[0], fixed_record_size)) return false;
+    size_t first = header.find(": "), second = header.find(": ", first + 1);
+    if (first == string::npos || second == string::npos) return false;
+    records = atoll(header.c_str() + first + 2);
+    removed = atoll(header.c_str() + second + 2);
+    bool dirty = header[header.size() - 2] == '*';
+    long long expected = (records + 2) * fixed_record_size;
+    file.clear();
+    file.seekg(0, ios::end);
+    long long actual = file.tellg();
+    if (actual == expected && !dirty) return true;
+    if (actual < expected) return false;
+
+    // Изменение на месте прервано: записи, дописанные после заголовка, отбрасываются
+    if (actual > expected) {
+        file.close();
+        if (!truncateFile(filename, expected)) return false;
+        file.clear();
+        file.open(filename, ios::in | ios::out | ios::binary);
+        if (!file) return false;
+    }
+    removed = 0;
+    for (long long i = 0; i < records; ++i) {
+        User u;
+        bool is_removed;
+        if (!read(i, u, is_removed)) return false;
+        if (is_removed) ++removed;
+    }
+    return writeHeader();
+}
+
+bool FixedReport::writeHeader(bool dirty) {
+    char counts[96];
+    snprintf(counts, sizeof(counts), "%010lld | %010lld | %lld", records, removed, fixed_record_size);
+    string header = u8"Записей: " + string(counts, 10) + u8" | Удалено: " + string(counts + 13, 10)
+        + u8" | Длина записи: " + (counts + 26);
+    header.append(static_cast<size_t>(fixed_record_size) - 1 - header.size(), ' ');
+    if (dirty) header.back() = '*';
+    header += '\n';
+    file.clear();
+    file.seekp(0);
+    return static_cast<bool>(file.write(header.data(), header.size()));
+}
+
+bool FixedReport::beginUpdate() {
+    // Пометка должна попасть в файл раньше любой измененной записи
+    return writeHeader(true) && file.flush();
+}
+
+bool FixedReport::read(long long index, User& u, bool& is_removed) {
+    string record;
+    return readRecord(index, record) && parseFixedRecord(record, u, is_removed);
+}
+
+long long FixedReport::find(int id) {
+    long long lo = 0, hi = records - 1;
+    char buf[11] = {};
+    while (lo <= hi) {
+        long long mid = lo + (hi - lo) / 2;
+        file.clear();
+        file.seekg((mid + 2) * fixed_record_size + fixed_widths[0] + 3);
+        if (!file.read(buf, 10)) return -1;
+        int mid_id = atoi(buf);
+        if (mid_id == id) return mid;
+        if (mid_id < id) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+int FixedReport::lastId() {
+    User u;
+    bool is_removed;
+    return records > 0 && read(records - 1, u, is_removed) ? u.id : 0;
+}
+
+bool FixedReport::update(long long index, const User& u) {
+    bool was_removed;
+    User old;
+    if (!read(index, old, was_removed)) return false;
+    if (was_removed) --removed;
+    return writeRecord(index, formatFixedRecord(u, false));
+}
+
+bool FixedReport::remove(long long index) {
+    User u;
+    bool was_removed;
+    if (!read(index, u, was_removed)) return false;
+    if (was_removed) return true;
+    ++removed;
+    return writeRecord(index, formatFixedRecord(u, true));
+}
+
+bool FixedReport::append(const User& u) {
+    if (!writeRecord(records, formatFixedRecord(u, false))) return false;
+    ++records;
+    return true;
+}
+
+bool FixedReport::close() {
+    bool ok = writeHeader();
+    file.close();
+    return ok && !file.fail();
+}
+
+long long writeFixedReport(const string& filename, ResultCursor& rows) {
+    string temp = FileBatch::tempName(filename);
+    FixedReport report;
+    if (!report.create(temp)) {
+        cerr << u8"Не удалось открыть файл: " << filename << endl;
+        return -1;
+    }
+    int last = 0;
+    bool ordered = true;
+    rows.forEach([&](const User& u) {
+        if (u.id <= last) {
+            ordered = false;
+            return false;
+        }
+        last = u.id;
+        report.append(u);
+        return true;
+        });
+    if (!ordered) {
+        vector<User> users;
+        rows.forEach([&](const User& u) {
+            users.push_back(u);
+            return true;
+            });
+        sort(users.begin(), users.end(), [](const User& a, const User& b) { return a.id < b.id; });
+        report.create(temp);
+        for (const auto& u : users) report.append(u);
+    }
+    long long count = report.size();
+    crashPoint();
+    if (!report.close()) {
+        cerr << u8"Ошибка записи файла: " << filename << endl;
+        remove(temp.c_str());
+        return -1;
+    }
+    FileBatch batch;
+    batch.add(filename);
+    return batch.commit() ? count : -1;
+}
+
+bool applyFixedChanges(const string& filename, const set<int>& deleted, const map<int, User>& inserted, FileBatch& batch) {
+    // Файл меняется на месте по записям
+    beforeFileChange(filename);
+    FixedReport report;
+    if (!report.open(filename)) {
+        cerr << u8"Некорректный файл отчета: " << filename << endl;
+        return false;
+    }
+    if (!report.beginUpdate()) {
+        cerr << u8"Ошибка записи файла: " << filename << endl;
+        return false;
+    }
+    for (int id : deleted) {
+        long long index = report.find(id);
+        if (index >= 0) report.remove(index);
+    }
+    vector<User> middle;
+    for (const auto& entry : inserted) {
+        long long index = report.find(entry.first);
+        if (index >= 0) report.update(index, entry.second);
+        else if (entry.first > report.lastId()) report.append(entry.second);
+        else middle.push_back(entry.second);
+    }
+    crashPoint();
+    if (middle.empty()) return report.close();
+
+    vector<User> users;
+    for (long long i = 0; i < report.size(); ++i) {
+        User u;
+        bool is_removed;
+        if (report.read(i, u, is_removed) && !is_removed) users.push_back(move(u));
+    }
+    report.close();
+    users.insert(users.end(), middle.begin(), middle.end());
+    sort(users.begin(), users.end(), [](const User& a, const User& b) { return a.id < b.id; });
+
+    string tmp_name = FileBatch::tempName(filename);
+    FixedReport rewritten;
+    if (!rewritten.create(tmp_name)) return false;
+    for (const auto& u : users) rewritten.append(u);
+    if (!rewritten.close()) {
+        remove(tmp_name.c_str());
+        return false;
+    }
+    batch.add(filename);
+    return true;
+}
+
+void registerReport(sqlite3* db, const string& filename, const string& kind, const string& param, long long position) {
+    string path = absolutePath(filename);
+    long long size = -1, mtime = -1;
+    fileStamp(path, size, mtime);
+    if (path != filename) {
+        // Запись прежней версии по имени в текущем каталоге заменяется записью по полному пути
+        SQLiteStmt old_entry(db, "DELETE FROM reports WHERE filename = ?;");
+        sqlite3_bind_text(old_entry.get(), 1, filename.c_str(), -1, SQLITE_STATIC);
+        sqlite3_step(old_entry.get());
+    }
+    SQLiteStmt stmt(db, "INSERT OR REPLACE INTO reports (filename, kind, param, position, size, mtime) VALUES (?, ?, ?, ?, ?, ?);");
+    sqlite3_bind_text(stmt.get(), 1, path.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt.get(), 2, kind.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt.get(), 3, param.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt.get(), 4, position);
+    sqlite3_bind_int64(stmt.get(), 5, size);
+    sqlite3_bind_int64(stmt.get(), 6, mtime);
+    if (sqlite3_step(stmt.get()) != SQLITE_DONE) {
+        cerr << u8"Ошибка регистрации файла отчета: " << sqlite3_errmsg(db) << endl;
+    }
+    pruneJournal(db);
+}
+
+bool reportMatches(const string& kind, const string& param, const User& u) {
+    if (kind == "year") return to_string(u.godrozh) == param;
+    if (kind == "street") return u.adres.find(param) != string::npos;
+    if (kind == "street_exact") return streetOf(u.adres) == param;
+    if (kind == "city") return u.mesto == param;
+    if (kind == "decade") return to_string(u.godrozh / 10 * 10) == param;
+    if (kind == "prefix_familiya") return u.familiya.compare(0, param.size(), param) == 0;
+    if (kind == "prefix_imya") return u.imya.compare(0, param.size(), param) == 0;
+    return true;
+}
+
+bool applyReportChanges(const string& filename, const string& kind, const string& param,
+    const set<int>& deleted, const map<int, User>& inserted, FileBatch& batch) {
+    PROFILE_SCOPE(ProfileExport);
+    if (filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".tbl") == 0) {
+        return applyFixedChanges(filename, deleted, inserted, batch);
+    }
+    vector<SortKey> keys;
+    if (kind == "sorted") keys = parseOrderBy(param);
+    else if (kind == "prefix_familiya") keys = { { 0, true } };
+    else if (kind == "prefix_imya") keys = { { 1, true } };
+
+    vector<pair<string, const User*>> pending;
+    pending.reserve(inserted.size());
+    for (const auto& entry : inserted) {
+        pending.push_back({ encodeReportKey(entry.second, keys), &entry.second });
+    }
+    sort(pending.begin(), pending.end(), [](const pair<string, const User*>& a, const pair<string, const User*>& b) {
+        return sortKeyLess(a.first, b.first);
+        });
+
+    ifstream in_file(filename);
+    if (!in_file) {
+        return false;
+    }
+    string tmp_name = FileBatch::tempName(filename);
+    ofstream out_file(tmp_name, ios::trunc);
+    if (!out_file) {
+        cerr << u8"Не удалось открыть файл для записи: " << tmp_name << endl;
+        return false;
+    }
+
+    size_t next = 0;
+    string line;
+    while (getline(in_file, line)) {
+        if (isHeaderLine(line)) {
+            out_file << line << endl;
+            continue;
+        }
+        User u;
+        if (!parseUserLine(line, u)) {
+            cerr << u8"Ошибка парсинга строки в файле " << filename << ": " << line << endl;
+            out_file << line << endl;
+            continue;
+        }
+        if (deleted.count(u.id)) continue;
+        string key = encodeReportKey(u, keys);
+        while (next < pending.size() && sortKeyLess(pending[next].first, key)) {
+            const User& p = *pending[next++].second;
+            printRow(out_file, p.id, p.familiya, p.imya, p.otchestvo, p.godrozh, p.adres, p.mesto);
+        }
+        if (next < pending.size() && pending[next].first == key) ++next;
+        out_file << line << endl;
+    }
+    for (; next < pending.size(); ++next) {
+        const User& p = *pending[next].second;
+        printRow(out_file, p.id, p.familiya, p.imya, p.otchestvo, p.godrozh, p.adres, p.mesto);
+    }
+    in_file.close();
+    crashPoint();
+    out_file.close();
+    if (!out_file) {
+        cerr << u8"Ошибка записи файла: " << tmp_name << endl;
+        remove(tmp_name.c_str());
+        return false;
+    }
+    batch.add(filename);
+    return true;
+}
+
+int syncReports(sqlite3* db, const string& only_file) {
+    struct ReportInfo {
+        string filename, kind, param;
+        long long position, size, mtime;
+    };
+    vector<ReportInfo> list;
+    {
+        string path = absolutePath(only_file);
+        SQLiteStmt stmt(db, only_file.empty()
+            ? "SELECT filename, kind, param, position, size, mtime FROM reports;"
+            : "SELECT filename, kind, param, position, size, mtime FROM reports WHERE filename IN (?, ?);");
+        if (!only_file.empty()) {
+            sqlite3_bind_text(stmt.get(), 1, path.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt.get(), 2, only_file.c_str(), -1, SQLITE_STATIC);
+        }
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+            list.push_back({ reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0)),
+                reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 1)),
+                reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 2)),
+                sqlite3_column_int64(stmt.get(), 3), sqlite3_column_int64(stmt.get(), 4),
+                sqlite3_column_int64(stmt.get(), 5) });
+        }
+    }
+    auto forget = [&](const string& filename) {
+        SQLiteStmt stmt(db, "DELETE FROM reports WHERE filename = ?;");
+        sqlite3_bind_text(stmt.get(), 1, filename.c_str(), -1, SQLITE_STATIC);
+        sqlite3_step(stmt.get());
+    };
+
+    FileBatch batch;
+    map<string, long long> positions;
+    vector<string> touched;
+    for (const auto& r : list) {
+        long long size, mtime;
+        if (!fileStamp(r.filename, size, mtime)) {
+            // Файл удален пользователем - больше его не отслеживаем
+            forget(r.filename);
+            continue;
+        }
+        if (r.size >= 0 && (size != r.size || mtime != r.mtime)) {
+            // Файл переписан другой базой данных с тем же именем отчета или вручную:
+            // изменения этой базы к нему больше не применяются
+            cerr << u8"Файл отчета изменен вне базы данных и больше не обновляется: " << r.filename << endl;
+            forget(r.filename);
+            continue;
+        }
+
+        set<int> deleted;
+        map<int, User> inserted;
+        long long last = r.position;
+        SQLiteStmt changes(db, "SELECT seq, op, user_id, familiya, imya, otchestvo, godrozh, adres, mesto "
+            "FROM changes WHERE seq > ? ORDER BY seq;");
+        sqlite3_bind_int64(changes.get(), 1, r.position);
+        while (sqlite3_step(changes.get()) == SQLITE_ROW) {
+            last = sqlite3_column_int64(changes.get(), 0);
+            string op = columnText(changes.get(), 1);
+            int user_id = sqlite3_column_int(changes.get(), 2);
+            if (op == "I") {
+                User u;
+                u.id = user_id;
+                readUserColumns(changes.get(), 3, u);
+                if (reportMatches(r.kind, r.param, u)) inserted[user_id] = u;
+            }
+            else {
+                inserted.erase(user_id);
+                deleted.insert(user_id);
+            }
+        }
+        if (last == r.position) continue;
+
+        // На время записи отметка снимается: файл, оставшийся после сбоя
+        // недообновленным, не должен считаться измененным извне
+        SQLiteStmt unstamp(db, "UPDATE reports SET size = -1 WHERE filename = ?;");
+        sqlite3_bind_text(unstamp.get(), 1, r.filename.c_str(), -1, SQLITE_STATIC);
+        sqlite3_step(unstamp.get());
+        touched.push_back(r.filename);
+
+        if (!applyReportChanges(r.filename, r.kind, r.param, deleted, inserted, batch)) continue;
+        positions[r.filename] = last;
+    }
+    bool committed = batch.commit();
+    for (const auto& filename : touched) {
+        long long size = -1, mtime = -1;
+        fileStamp(filename, size, mtime);
+        auto p = positions.find(filename);
+        bool moved = committed && p != positions.end();
+        SQLiteStmt update(db, moved
+            ? "UPDATE reports SET size = ?, mtime = ?, position = ? WHERE filename = ?;"
+            : "UPDATE reports SET size = ?, mtime = ? WHERE filename = ?;");
+        sqlite3_bind_int64(update.get(), 1, size);
+        sqlite3_bind_int64(update.get(), 2, mtime);
+        if (moved) sqlite3_bind_int64(update.get(), 3, p->second);
+        sqlite3_bind_text(update.get(), moved ? 4 : 3, filename.c_str(), -1, SQLITE_STATIC);
+        sqlite3_step(update.get());
+    }
+    if (!committed) return 0;
+    pruneJournal(db);
+    return static_cast<int>(positions.size());
+}
+
+string streetOf(const string& adres) {
+    size_t start = adres.find(' ');
+    size_t end = adres.find(',');
+    if (start == string::npos || end == string::npos || end <= start) return adres;
+    return adres.substr(start + 1, end - start - 1);
+}
+
+uint64_t hashString(const string& str) {
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : str) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+void putInt(string& out, int64_t v) {
+    for (int i = 0; i < 8; ++i) out.push_back(static_cast<char>(static_cast<uint64_t>(v) >> (8 * i)));
+}
+
+int64_t getInt(const string& in, size_t& pos) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8 && pos < in.size(); ++i) v |= static_cast<uint64_t>(static_cast<unsigned char>(in[pos++])) << (8 * i);
+    return static_cast<int64_t>(v);
+}
+
+void HyperLogLog::add(const string& value) {
+    uint64_t h = hashString(value);
+    size_t index = static_cast<size_t>(h >> (64 - p));
+    uint64_t rest = h << p;
+    char rank = 1;
+    while (rank <= 64 - p && !(rest & 0x8000000000000000ull)) {
+        ++rank;
+        rest <<= 1;
+    }
+    if (registers[index] < rank) registers[index] = rank;
+}
+
+double HyperLogLog::estimate() const {
+    double m = static_cast<double>(registers.size());
+    double sum = 0;
+    int zeros = 0;
+    for (char r : registers) {
+        sum += 1.0 / static_cast<double>(1ull << r);
+        if (r == 0) ++zeros;
+    }
+    double e = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (e <= 2.5 * m && zeros > 0) e = m * log(m / zeros);
+    return e;
+}
+
+void HyperLogLog::load(const string& in, size_t& pos) {
+    registers = in.substr(pos, registers.size());
+    registers.resize(1 << p, '\0');
+    pos += registers.size();
+}
+
+int64_t CountMinSketch::estimate(const string& value) const {
+    uint64_t h = hashString(value);
+    uint32_t h1 = static_cast<uint32_t>(h), h2 = static_cast<uint32_t>(h >> 32);
+    int64_t result = counts[h1 % width];
+    for (int i = 1; i < depth; ++i) {
+        int64_t c = counts[i * width + (h1 + i * h2) % width];
+        if (c < result) result = c;
+    }
+    return result;
+}
+
+void CountMinSketch::add(const string& value, int64_t delta) {
+    uint64_t h = hashString(value);
+    uint32_t h1 = static_cast<uint32_t>(h), h2 = static_cast<uint32_t>(h >> 32);
+    for (int i = 0; i < depth; ++i) {
+        counts[i * width + (h1 + i * h2) % width] += delta;
+    }
+    int64_t est = estimate(value);
+    auto it = candidates.find(value);
+    if (it != candidates.end()) {
+        it->second = est;
+        return;
+    }
+    if (delta < 0) return;
+    if (candidates.size() < max_candidates) {
+        candidates[value] = est;
+        return;
+    }
+    auto lowest = candidates.begin();
+    for (auto c = candidates.begin(); c != candidates.end(); ++c) {
+        if (c->second < lowest->second) lowest = c;
+    }
+    if (est > lowest->second) {
+        candidates.erase(lowest);
+        candidates[value] = est;
+    }
+}
+
+vector<pair<string, int64_t>> CountMinSketch::top(size_t n) const {
+    vector<pair<string, int64_t>> result(candidates.begin(), candidates.end());
+    sort(result.begin(), result.end(), [](const pair<string, int64_t>& a, const pair<string, int64_t>& b) {
+        return a.second > b.second;
+        });
+    if (result.size() > n) result.resize(n);
+    return result;
+}
+
+void CountMinSketch::save(string& out) const {
+    for (int64_t c : counts) putInt(out, c);
+    putInt(out, candidates.size());
+    for (const auto& c : candidates) {
+        putInt(out, c.first.size());
+        out += c.first;
+        putInt(out, c.second);
+    }
+}
+
+void CountMinSketch::load(const string& in, size_t& pos) {
+    for (auto& c : counts) c = getInt(in, pos);
+    candidates.clear();
+    int64_t n = getInt(in, pos);
+    for (int64_t i = 0; i < n && pos < in.size(); ++i) {
+        size_t len = static_cast<size_t>(getInt(in, pos));
+        string value = in.substr(pos, len);
+        pos += len;
+        candidates[value] = getInt(in, pos);
+    }
+}
+
+void VoterStats::add(const User& u) {
+    ++total;
+    string street = streetOf(u.adres);
+    distinct_familiya.add(u.familiya);
+    distinct_mesto.add(u.mesto);
+    distinct_street.add(street);
+    top_mesto.add(u.mesto, 1);
+    top_street.add(street, 1);
+    ++years[u.godrozh];
+}
+
+void VoterStats::remove(const User& u) {
+    --total;
+    ++deletes;
+    top_mesto.add(u.mesto, -1);
+    top_street.add(streetOf(u.adres), -1);
+    if (--years[u.godrozh] <= 0) years.erase(u.godrozh);
+}
+
+string VoterStats::save() const {
+    string out;
+    putInt(out, total);
+    putInt(out, deletes);
+    distinct_familiya.save(out);
+    distinct_mesto.save(out);
+    distinct_street.save(out);
+    top_mesto.save(out);
+    top_street.save(out);
+    putInt(out, years.size());
+    for (const auto& y : years) {
+        putInt(out, y.first);
+        putInt(out, y.second);
+    }
+    return out;
+}
+
+void VoterStats::load(const string& in) {
+    size_t pos = 0;
+    total = getInt(in, pos);
+    deletes = getInt(in, pos);
+    distinct_familiya.load(in, pos);
+    distinct_mesto.load(in, pos);
+    distinct_street.load(in, pos);
+    top_mesto.load(in, pos);
+    top_street.load(in, pos);
+    years.clear();
+    int64_t n = getInt(in, pos);
+    for (int64_t i = 0; i < n; ++i) {
+        int year = static_cast<int>(getInt(in, pos));
+        years[year] = getInt(in, pos);
+    }
+}
+
+void saveStats(sqlite3* db, const VoterStats& stats, long long position) {
+    string data = stats.save();
+    SQLiteStmt stmt(db, "INSERT OR REPLACE INTO stats (name, position, data) VALUES ('voters', ?, ?);");
+    sqlite3_bind_int64(stmt.get(), 1, position);
+    sqlite3_bind_blob(stmt.get(), 2, data.data(), static_cast<int>(data.size()), SQLITE_STATIC);
+    if (sqlite3_step(stmt.get()) != SQLITE_DONE) {
+        cerr << u8"Ошибка сохранения статистики: " << sqlite3_errmsg(db) << endl;
+    }
+}
+
+VoterStats rebuildStats(sqlite3* db) {
+    VoterStats stats;
+    long long position = journalPosition(db);
+    SQLiteStmt stmt(db, "SELECT familiya, imya, otchestvo, godrozh, adres, mesto FROM users;");
+    while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+        User u;
+        readUserColumns(stmt.get(), 0, u);
+        stats.add(u);
+    }
+    saveStats(db, stats, position);
+    return stats;
+}
+
+VoterStats syncStats(sqlite3* db) {
+    VoterStats stats;
+    long long position;
+    {
+        SQLiteStmt stmt(db, "SELECT position, data FROM stats WHERE name = 'voters';");
+        if (sqlite3_step(stmt.get()) != SQLITE_ROW) {
+            return rebuildStats(db);
+        }
+        position = sqlite3_column_int64(stmt.get(), 0);
+        const char* data = static_cast<const char*>(sqlite3_column_blob(stmt.get(), 1));
+        stats.load(string(data ? data : "", sqlite3_column_bytes(stmt.get(), 1)));
+    }
+
+    long long last = position;
+    SQLiteStmt changes(db, "SELECT seq, op, familiya, imya, otchestvo, godrozh, adres, mesto "
+        "FROM changes WHERE seq > ? ORDER BY seq;");
+    sqlite3_bind_int64(changes.get(), 1, position);
+    while (sqlite3_step(changes.get()) == SQLITE_ROW) {
+        last = sqlite3_column_int64(changes.get(), 0);
+        User u;
+        readUserColumns(changes.get(), 2, u);
+        if (columnText(changes.get(), 1) == "I") stats.add(u);
+        else stats.remove(u);
+    }
+    if (last != position) {
+        saveStats(db, stats, last);
+        pruneJournal(db);
+    }
+    return stats;
+}
+
+int popcount64(uint64_t x) {
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<int>((x * 0x0101010101010101ULL) >> 56);
+}
+
+BitmapIndex bitmap_index;
+
+YearIndex year_index;
+
+bool RoaringBitmap::Container::contains(uint16_t low) const {
+    if (isBitmap()) return (bits[low >> 6] >> (low & 63)) & 1;
+    return binary_search(array.begin(), array.end(), low);
+}
+
+void RoaringBitmap::Container::toBitmap() {
+    bits.assign(1024, 0);
+    for (uint16_t low : array) bits[low >> 6] |= 1ULL << (low & 63);
+    vector<uint16_t>().swap(array);
+}
+
+void RoaringBitmap::Container::toArray() {
+    array.clear();
+    array.reserve(cardinality);
+    for (uint32_t w = 0; w < 1024; ++w) {
+        for (uint64_t word = bits[w]; word; word &= word - 1) {
+            int bit = 0;
+            while (!((word >> bit) & 1)) ++bit;
+            array.push_back(static_cast<uint16_t>(w * 64 + bit));
+        }
+    }
+    vector<uint64_t>().swap(bits);
+}
+
+void RoaringBitmap::Container::normalize() {
+    if (isBitmap() && cardinality <= 4096) toArray();
+    else if (!isBitmap() && cardinality > 4096) toBitmap();
+}
+
+vector<RoaringBitmap::Container>::iterator RoaringBitmap::find(uint16_t key) {
+    return lower_bound(containers.begin(), containers.end(), key,
+        [](const Container& c, uint16_t k) { return c.key < k; });
+}
+
+void RoaringBitmap::add(uint32_t id) {
+    uint16_t key = static_cast<uint16_t>(id >> 16), low = static_cast<uint16_t>(id);
+    auto it = find(key);
+    if (it == containers.end() || it->key != key) {
+        it = containers.insert(it, Container());
+        it->key = key;
+    }
+    if (it->isBitmap()) {
+        uint64_t& word = it->bits[low >> 6];
+        if ((word >> (low & 63)) & 1) return;
+        word |= 1ULL << (low & 63);
+    }
+    else {
+        auto pos = lower_bound(it->array.begin(), it->array.end(), low);
+        if (pos != it->array.end() && *pos == low) return;
+        it->array.insert(pos, low);
+    }
+    ++it->cardinality;
+    it->normalize();
+}
+
+void RoaringBitmap::remove(uint32_t id) {
+    uint16_t key = static_cast<uint16_t>(id >> 16), low = static_cast<uint16_t>(id);
+    auto it = find(key);
+    if (it == containers.end() || it->key != key || !it->contains(low)) return;
+    if (it->isBitmap()) it->bits[low >> 6] &= ~(1ULL << (low & 63));
+    else it->array.erase(lower_bound(it->array.begin(), it->array.end(), low));
+    if (--it->cardinality == 0) containers.erase(it);
+    else it->normalize();
+}
+
+uint64_t RoaringBitmap::cardinality() const {
+    uint64_t total = 0;
+    for (const auto& c : containers) total += c.cardinality;
+    return total;
+}
+
+vector<uint32_t> RoaringBitmap::values() const {
+    vector<uint32_t> out;
+    out.reserve(static_cast<size_t>(cardinality()));
+    for (const auto& c : containers) {
+        uint32_t high = static_cast<uint32_t>(c.key) << 16;
+        if (c.isBitmap()) {
+            for (uint32_t low = 0; low < 65536; ++low) {
+                if ((c.bits[low >> 6] >> (low & 63)) & 1) out.push_back(high | low);
+            }
+        }
+        else {
+            for (uint16_t low : c.array) out.push_back(high | low);
+        }
+    }
+    return out;
+}
+
+RoaringBitmap RoaringBitmap::intersect(const RoaringBitmap& a, const RoaringBitmap& b) {
+    RoaringBitmap result;
+    size_t i = 0, j = 0;
+    while (i < a.containers.size() && j < b.containers.size()) {
+        const Container& x = a.containers[i];
+        const Container& y = b.containers[j];
+        if (x.key < y.key) { ++i; continue; }
+        if (y.key < x.key) { ++j; continue; }
+        Container c;
+        c.key = x.key;
+        if (x.isBitmap() && y.isBitmap()) {
+            c.bits.resize(1024);
+            for (int w = 0; w < 1024; ++w) {
+                c.bits[w] = x.bits[w] & y.bits[w];
+                c.cardinality += popcount64(c.bits[w]);
+            }
+        }
+        else if (!x.isBitmap() && !y.isBitmap()) {
+            set_intersection(x.array.begin(), x.array.end(), y.array.begin(), y.array.end(), back_inserter(c.array));
+            c.cardinality = static_cast<uint32_t>(c.array.size());
+        }
+        else {
+            const Container& arr = x.isBitmap() ? y : x;
+            const Container& bmp = x.isBitmap() ? x : y;
+            for (uint16_t low : arr.array) {
+                if (bmp.contains(low)) c.array.push_back(low);
+            }
+            c.cardinality = static_cast<uint32_t>(c.array.size());
+        }
+        if (c.cardinality > 0) {
+            c.normalize();
+            result.containers.push_back(move(c));
+        }
+        ++i;
+        ++j;
+    }
+    return result;
+}
+
+RoaringBitmap RoaringBitmap::unite(const RoaringBitmap& a, const RoaringBitmap& b) {
+    RoaringBitmap result;
+    size_t i = 0, j = 0;
+    while (i < a.containers.size() || j < b.containers.size()) {
+        if (j == b.containers.size() || (i < a.containers.size() && a.containers[i].key < b.containers[j].key)) {
+            result.containers.push_back(a.containers[i++]);
+            continue;
+        }
+        if (i == a.containers.size() || b.containers[j].key < a.containers[i].key) {
+            result.containers.push_back(b.containers[j++]);
+            continue;
+        }
+        const Container& x = a.containers[i++];
+        const Container& y = b.containers[j++];
+        Container c;
+        c.key = x.key;
+        if (!x.isBitmap() && !y.isBitmap()) {
+            set_union(x.array.begin(), x.array.end(), y.array.begin(), y.array.end(), back_inserter(c.array));
+            c.cardinality = static_cast<uint32_t>(c.array.size());
+        }
+        else {
+            c.bits.assign(1024, 0);
+            for (const Container* src : { &x, &y }) {
+                if (src->isBitmap()) {
+                    for (int w = 0; w < 1024; ++w) c.bits[w] |= src->bits[w];
+                }
+                else {
+                    for (uint16_t low : src->array) c.bits[low >> 6] |= 1ULL << (low & 63);
+                }
+            }
+            for (int w = 0; w < 1024; ++w) c.cardinality += popcount64(c.bits[w]);
+        }
+        c.normalize();
+        result.containers.push_back(move(c));
+    }
+    return result;
+}
+
+void RoaringBitmap::save(string& out) const {
+    putInt(out, containers.size());
+    for (const auto& c : containers) {
+        putInt(out, c.key);
+        putInt(out, c.cardinality);
+        if (c.isBitmap()) out.append(reinterpret_cast<const char*>(c.bits.data()), c.bits.size() * sizeof(uint64_t));
+        else out.append(reinterpret_cast<const char*>(c.array.data()), c.array.size() * sizeof(uint16_t));
+    }
+}
+
+bool RoaringBitmap::load(const string& in, size_t& pos) {
+    containers.clear();
+    int64_t n = getInt(in, pos);
+    for (int64_t k = 0; k < n; ++k) {
+        Container c;
+        c.key = static_cast<uint16_t>(getInt(in, pos));
+        c.cardinality = static_cast<uint32_t>(getInt(in, pos));
+        if (c.cardinality == 0 || c.cardinality > 65536) return false;
+        size_t bytes = c.cardinality > 4096 ? 1024 * sizeof(uint64_t) : c.cardinality * sizeof(uint16_t);
+        if (pos + bytes > in.size()) return false;
+        if (c.cardinality > 4096) {
+            c.bits.resize(1024);
+            memcpy(c.bits.data(), in.data() + pos, bytes);
+        }
+        else {
+            c.array.resize(c.cardinality);
+            memcpy(c.array.data(), in.data() + pos, bytes);
+        }
+        pos += bytes;
+        containers.push_back(move(c));
+    }
+    return true;
+}
+
+void BitmapIndex::clear() {
+    years.clear();
+    cities.clear();
+    streets.clear();
+}
+
+void BitmapIndex::add(const User& u) {
+    years[u.godrozh].add(static_cast<uint32_t>(u.id));
+    cities[u.mesto].add(static_cast<uint32_t>(u.id));
+    streets[streetOf(u.adres)].add(static_cast<uint32_t>(u.id));
+}
+
+void BitmapIndex::remove(const User& u) {
+    auto dropFrom = [&u](auto& index, const auto& value) {
+        auto it = index.find(value);
+        if (it == index.end()) return;
+        it->second.remove(static_cast<uint32_t>(u.id));
+        if (it->second.empty()) index.erase(it);
+    };
+    dropFrom(years, u.godrozh);
+    dropFrom(cities, u.mesto);
+    dropFrom(streets, streetOf(u.adres));
+}
+
+string BitmapIndex::save() const {
+    string out;
+    putInt(out, position);
+    putInt(out, years.size());
+    for (const auto& y : years) {
+        putInt(out, y.first);
+        y.second.save(out);
+    }
+    for (const auto* index : { &cities, &streets }) {
+        putInt(out, index->size());
+        for (const auto& entry : *index) {
+            putInt(out, entry.first.size());
+            out += entry.first;
+            entry.second.save(out);
+        }
+    }
+    return out;
+}
+
+bool BitmapIndex::load(const string& in) {
+    clear();
+    size_t pos = 0;
+    position = getInt(in, pos);
+    int64_t n = getInt(in, pos);
+    for (int64_t i = 0; i < n; ++i) {
+        int year = static_cast<int>(getInt(in, pos));
+        if (!years[year].load(in, pos)) return false;
+    }
+    for (auto* index : { &cities, &streets }) {
+        n = getInt(in, pos);
+        for (int64_t i = 0; i < n; ++i) {
+            size_t len = static_cast<size_t>(getInt(in, pos));
+            if (pos + len > in.size()) return false;
+            string value = in.substr(pos, len);
+            pos += len;
+            if (!(*index)[value].load(in, pos)) return false;
+        }
+    }
+    return pos == in.size();
+}
+
+void YearIndex::build(const map<int, RoaringBitmap>& years) {
+    counts.clear();
+    prefix.assign(1, 0);
+    if (years.empty()) return;
+    first_year = years.begin()->first;
+    counts.assign(static_cast<size_t>(years.rbegin()->first - first_year + 1), 0);
+    for (const auto& y : years) counts[y.first - first_year] = static_cast<int64_t>(y.second.cardinality());
+    prefix.resize(counts.size() + 1);
+    for (size_t i = 0; i < counts.size(); ++i) prefix[i + 1] = prefix[i] + counts[i];
+}
+
+int64_t YearIndex::countRange(int from, int to) const {
+    if (counts.empty()) return 0;
+    if (from < first_year) from = first_year;
+    if (to > lastYear()) to = lastYear();
+    if (from > to) return 0;
+    return prefix[to - first_year + 1] - prefix[from - first_year];
+}
+
+void saveBitmaps(sqlite3* db) {
+    string filename = bitmap_index.db_name + ".bitmaps";
+    string data = bitmap_index.save();
+    beforeFileChange(filename);
+    ofstream file(filename, ios::binary | ios::trunc);
+    file.write(data.data(), data.size());
+    file.close();
+    if (!file) {
+        cerr << u8"Ошибка записи файла индексов: " << filename << endl;
+        return;
+    }
+    SQLiteStmt stmt(db, "INSERT OR REPLACE INTO stats (name, position, data) VALUES ('bitmaps', ?, '');");
+    sqlite3_bind_int64(stmt.get(), 1, bitmap_index.position);
+    sqlite3_step(stmt.get());
+}
+
+void rebuildBitmaps(sqlite3* db) {
+    bitmap_index.clear();
+    sqlite3_exec(db, "SAVEPOINT bitmaps;", nullptr, nullptr, nullptr);
+    bitmap_index.position = journalPosition(db);
+    {
+        SQLiteStmt stmt(db, "SELECT id, familiya, imya, otchestvo, godrozh, adres, mesto FROM users;");
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+            User u;
+            u.id = sqlite3_column_int(stmt.get(), 0);
+            readUserColumns(stmt.get(), 1, u);
+            bitmap_index.add(u);
+        }
+    }
+    sqlite3_exec(db, "RELEASE bitmaps;", nullptr, nullptr, nullptr);
+    saveBitmaps(db);
+    year_index.build(bitmap_index.years);
+}
+
+void syncBitmaps(sqlite3* db) {
+    string db_name = sqlite3_db_filename(db, "main") ? sqlite3_db_filename(db, "main") : "";
+    if (bitmap_index.db_name != db_name) {
+        bitmap_index.db_name = db_name;
+        long long saved = -1;
+        {
+            SQLiteStmt stmt(db, "SELECT position FROM stats WHERE name = 'bitmaps';");
+            if (sqlite3_step(stmt.get()) == SQLITE_ROW) saved = sqlite3_column_int64(stmt.get(), 0);
+        }
+        ifstream file(db_name + ".bitmaps", ios::binary);
+        string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        if (!file || data.empty() || !bitmap_index.load(data) || bitmap_index.position != saved) {
+            rebuildBitmaps(db);
+            return;
+        }
+    }
+
+    long long last = bitmap_index.position;
+    SQLiteStmt changes(db, "SELECT seq, op, user_id, familiya, imya, otchestvo, godrozh, adres, mesto "
+        "FROM changes WHERE seq > ? ORDER BY seq;");
+    sqlite3_bind_int64(changes.get(), 1, bitmap_index.position);
+    while (sqlite3_step(changes.get()) == SQLITE_ROW) {
+        last = sqlite3_column_int64(changes.get(), 0);
+        User u;
+        u.id = sqlite3_column_int(changes.get(), 2);
+        readUserColumns(changes.get(), 3, u);
+        if (columnText(changes.get(), 1) == "I") bitmap_index.add(u);
+        else bitmap_index.remove(u);
+    }
+    year_index.build(bitmap_index.years);
+    if (last != bitmap_index.position) {
+        bitmap_index.position = last;
+        saveBitmaps(db);
+        pruneJournal(db);
+    }
+}
+
+string formatExtension(int format) {
+    switch (format) {
+    case FormatCsv: return ".csv";
+    case FormatJson: return ".json";
+    case FormatNdjson: return ".ndjson";
+    case FormatFixed: return ".tbl";
+    default: return ".txt";
+    }
+}
+
+void putCsvField(OutputBuffer& out, const char* text, size_t len) {
+    bool quote = false;
+    for (size_t i = 0; i < len && !quote; ++i) {
+        char c = text[i];
+        quote = c == ',' || c == '"' || c == '\r' || c == '\n';
+    }
+    if (!quote) {
+        out.put(text, len);
+        return;
+    }
+    out.put('"');
+    size_t start = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (text[i] == '"') {
+            out.put(text + start, i - start + 1);
+            out.put('"');
+            start = i + 1;
+        }
+    }
+    out.put(text + start, len - start);
+    out.put('"');
+}
+
+void putJsonString(OutputBuffer& out, const char* text, size_t len) {
+    out.put('"');
+    size_t start = 0;
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = text[i];
+        if (c != '"' && c != '\\' && c >= 0x20) continue;
+        out.put(text + start, i - start);
+        start = i + 1;
+        if (c == '"') out.put("\\\"", 2);
+        else if (c == '\\') out.put("\\\\", 2);
+        else if (c == '\n') out.put("\\n", 2);
+        else if (c == '\r') out.put("\\r", 2);
+        else if (c == '\t') out.put("\\t", 2);
+        else {
+            char esc[7];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out.put(esc, 6);
+        }
+    }
+    out.put(text + start, len - start);
+    out.put('"');
+}
+
+RowWriter::RowWriter(OutputBuffer& out, int format, const vector<string>& names)
+    : out(out), format(format), keys(names.size()) {
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (format == FormatCsv) {
+            if (i > 0) out.put(',');
+            putCsvField(out, names[i].data(), names[i].size());
+        }
+        else {
+            keys[i] = string(i == 0 ? "{\"" : ",\"") + names[i] + "\":";
+        }
+    }
+    if (format == FormatCsv) out.put("\r\n", 2);
+    if (format == FormatJson) out.put('[');
+}
+
+void RowWriter::beginRow() {
+    if (format == FormatJson) out.put(count == 0 ? "\n" : ",\n");
+}
+
+void RowWriter::value(int i, const char* text, size_t len, bool number) {
+    if (format == FormatCsv) {
+        if (i > 0) out.put(',');
+        if (text) putCsvField(out, text, len);
+    }
+    else {
+        out.put(keys[i].data(), keys[i].size());
+        if (!text) out.put("null", 4);
+        else if (number) out.put(text, len);
+        else putJsonString(out, text, len);
+    }
+}
+
+void RowWriter::endRow() {
+    if (format == FormatCsv) out.put("\r\n", 2);
+    else out.put(format == FormatNdjson ? "}\n" : "}");
+    ++count;
+}
+
+void RowWriter::user(const User& u) {
+    char id[16], godrozh[16];
+    int id_len = snprintf(id, sizeof(id), "%d", u.id), godrozh_len = snprintf(godrozh, sizeof(godrozh), "%d", u.godrozh);
+    const char* text[] = { id, u.familiya.data(), u.imya.data(), u.otchestvo.data(), godrozh, u.adres.data(), u.mesto.data() };
+    size_t len[] = { static_cast<size_t>(id_len), u.familiya.size(), u.imya.size(), u.otchestvo.size(),
+        static_cast<size_t>(godrozh_len), u.adres.size(), u.mesto.size() };
+    beginRow();
+    for (int i = 0; i < static_cast<int>(keys.size()) && i < 7; ++i) value(i, text[i], len[i], i == 0 || i == 4);
+    endRow();
+}
+
+void RowWriter::finish() {
+    if (format == FormatJson) out.put(count == 0 ? "]\n" : "\n]\n");
+}
+
+long long exportRows(const string& filename, ResultCursor& rows, int format) {
+    PROFILE_SCOPE(ProfileExport);
+    string temp = FileBatch::tempName(filename);
+    ofstream file(temp, ios::binary | ios::trunc);
+    if (!file) {
+        cerr << u8"Не удалось открыть файл: " << filename << endl;
+        return -1;
+    }
+    long long count = 0;
+    {
+        OutputBuffer out(file, 4 << 20);
+        sqlite3_stmt* stmt = rows.statement();
+        int columns = sqlite3_column_count(stmt);
+        vector<string> names;
+        for (int i = 0; i < columns; ++i) names.push_back(sqlite3_column_name(stmt, i));
+        RowWriter writer(out, format, names);
+        rows.forEachRaw(
+            // Строки, сохраненные курсором (повторный обход): столбцы users
+            [&](const User& u) {
+                writer.user(u);
+                return true;
+            },
+            // Новые строки - прямо из запроса, без копирования
+            [&](sqlite3_stmt* row) {
+                writer.beginRow();
+                for (int i = 0; i < columns; ++i) {
+                    int type = sqlite3_column_type(row, i);
+                    const char* text = reinterpret_cast<const char*>(sqlite3_column_text(row, i));
+                    size_t len = static_cast<size_t>(sqlite3_column_bytes(row, i));
+                    writer.value(i, text, len, type == SQLITE_INTEGER || type == SQLITE_FLOAT);
+                }
+                writer.endRow();
+                return true;
+            });
+        writer.finish();
+        count = writer.rows();
+    }
+    crashPoint();
+    file.close();
+    if (!file) {
+        cerr << u8"Ошибка записи файла: " << filename << endl;
+        remove(temp.c_str());
+        return -1;
+    }
+    FileBatch batch;
+    batch.add(filename);
+    return batch.commit() ? count : -1;
+}
+
+ExportJob::ExportJob(int id, const string& db_name, const string& sql, const string& filename, const string& kind, const string& param)
+    : id(id), filename(filename), db_name(db_name), sql(sql), kind(kind), param(param),
+    row_queue(8), text_queue(8), started(chrono::steady_clock::now()) {
+    producer = thread(&ExportJob::produce, this);
+    formatter = thread(&ExportJob::format, this);
+    writer = thread(&ExportJob::writeOut, this);
+}
+
+ExportJob::~ExportJob() {
+    if (state == Running) cancel();
+    wait();
+}
+
+void ExportJob::cancel() {
+    cancelled = true;
+    row_queue.close();
+    text_queue.close();
+}
+
+void ExportJob::wait() {
+    if (producer.joinable()) producer.join();
+    if (formatter.joinable()) formatter.join();
+    if (writer.joinable()) writer.join();
+}
+
+string ExportJob::holdName() const {
+    return "export:" + to_string(currentProcessId()) + ":" + filename;
+}
+
+double ExportJob::seconds() const {
+    auto end = state == Running ? chrono::steady_clock::now() : finished;
+    return chrono::duration<double>(end - started).count();
+}
+
+void ExportJob::produce() {
+    PROFILE_SCOPE(ProfileExport);
+    SQLiteDB db(db_name);
+    if (!kind.empty()) {
+        // Журнал не должен очищаться дальше снимка, пока отчет не зарегистрирован:
+        // запись в stats удерживает позицию до завершения выгрузки (см. releaseJournal)
+        SQLiteStmt hold(db.get(), "INSERT OR REPLACE INTO stats (name, position, data) VALUES (?, ?, '');");
+        sqlite3_bind_text(hold.get(), 1, holdName().c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(hold.get(), 2, journalPosition(db.get()));
+        sqlite3_step(hold.get());
+    }
+    sqlite3_exec(db.get(), "BEGIN;", nullptr, nullptr, nullptr);
+    position = journalPosition(db.get());
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(db.get(), sql.c_str(), -1, &stmt, nullptr);
+    if (rc == SQLITE_OK) {
+        vector<User> batch;
+        batch.reserve(1024);
+        while (!cancelled && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            User u;
+            u.id = sqlite3_column_int(stmt, 0);
+            readUserColumns(stmt, 1, u);
+            batch.push_back(move(u));
+            if (batch.size() == 1024) {
+                row_queue.push(move(batch));
+                batch.clear();
+                batch.reserve(1024);
+            }
+        }
+        if (!batch.empty()) row_queue.push(move(batch));
+    }
+    if (rc != SQLITE_DONE && !cancelled) {
+        cerr << u8"\nОшибка фоновой выгрузки " << id << ": " << sqlite3_errmsg(db.get()) << endl;
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_exec(db.get(), "COMMIT;", nullptr, nullptr, nullptr);
+    read_ok = rc == SQLITE_DONE;
+    row_queue.close();
+}
+
+void ExportJob::format() {
+    PROFILE_SCOPE(ProfileExport);
+    ostringstream out;
+    long long pending = 0;
+    printTableHeader(out);
+    vector<User> batch;
+    while (!cancelled && row_queue.pop(batch)) {
+        for (const auto& u : batch) {
+            printRow(out, u.id, u.familiya, u.imya, u.otchestvo, u.godrozh, u.adres, u.mesto);
+        }
+        pending += batch.size();
+        if (out.tellp() >= (1 << 20)) {
+            text_queue.push({ out.str(), pending });
+            out.str("");
+            pending = 0;
+        }
+    }
+    if (!cancelled) text_queue.push({ out.str(), pending });
+    text_queue.close();
+}
+
+void ExportJob::writeOut() {
+    PROFILE_SCOPE(ProfileExport);
+    string temp = FileBatch::tempName(filename);
+    ofstream file(temp, ios::trunc);
+    pair<string, long long> chunk;
+    while (!cancelled && text_queue.pop(chunk)) {
+        file.write(chunk.first.data(), chunk.first.size());
+        bytes += chunk.first.size();
+        rows += chunk.second;
+    }
+    file.close();
+    finished = chrono::steady_clock::now();
+    if (cancelled) {
+        remove(temp.c_str());
+        releaseJournal(false);
+        state = Cancelled;
+        return;
+    }
+    if (!file || !read_ok) {
+        remove(temp.c_str());
+        releaseJournal(false);
+        state = Failed;
+        return;
+    }
+    FileBatch batch;
+    batch.add(filename);
+    bool ok = batch.commit();
+    releaseJournal(ok);
+    state = ok ? Done : Failed;
+}
+
+void ExportJob::releaseJournal(bool registered) {
+    if (kind.empty()) return;
+    SQLiteDB db(db_name);
+    sqlite3_exec(db.get(), "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr);
+    SQLiteStmt release(db.get(), "DELETE FROM stats WHERE name = ?;");
+    sqlite3_bind_text(release.get(), 1, holdName().c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_step(release.get());
+    if (registered) registerReport(db.get(), filename, kind, param, position);
+    sqlite3_exec(db.get(), "COMMIT;", nullptr, nullptr, nullptr);
+}
+
+void deleteUserById(sqlite3* db, int id) {
+    SQLiteStmt delete_stmt(db, "DELETE FROM users WHERE id = ?;");
+    sqlite3_bind_int(delete_stmt.get(), 1, id);
+    if (sqlite3_step(delete_stmt.get()) != SQLITE_DONE) {
+        cerr << u8"Ошибка удаления из базы данных: " << sqlite3_errmsg(db) << endl;
+        return;
+    }
+
+    if (sqlite3_changes(db) == 0) {
+        cout << u8"Пользователь с ID " << id << u8" не найден в базе данных." << endl;
+        return;
+    }
+
+    cout << u8"Данные успешно удалены из базы данных." << endl;
+    syncStats(db);
+    syncBitmaps(db);
+}
+
+long long externalSortReport(const string& source, const string& target, const vector<SortKey>& keys) {
+    PROFILE_SCOPE(ProfileSort);
+    vector<string> runs;
+    vector<User> portion;
+    bool failed = false;
+    auto flushRun = [&]() {
+        if (portion.empty()) return;
+        sortUsers(portion, keys);
+        string run_name = target + ".run" + to_string(runs.size());
+        ofstream run(run_name, ios::binary | ios::trunc);
+        for (const auto& u : portion) printRow(run, u.id, u.familiya, u.imya, u.otchestvo, u.godrozh, u.adres, u.mesto);
+        run.close();
+        if (!run) failed = true;
+        runs.push_back(run_name);
+        portion.clear();
+    };
+    long long count = ReportPipeline(source).run([&](const User& u) {
+        portion.push_back(u);
+        if (portion.size() == sort_run_rows) flushRun();
+        });
+    flushRun();
+
+    if (count >= 0 && !failed) {
+        ofstream out(target, ios::binary | ios::trunc);
+        printTableHeader(out);
+        // Текущая строка каждого временного файла; при равных ключах первой
+        // выводится строка из более раннего файла, поэтому сортировка устойчива
+        vector<unique_ptr<ifstream>> inputs;
+        vector<User> heads(runs.size());
+        typedef pair<string, size_t> HeapItem;
+        auto greater = [](const HeapItem& a, const HeapItem& b) {
+            if (a.first != b.first) return sortKeyLess(b.first, a.first);
+            return a.second > b.second;
+        };
+        priority_queue<HeapItem, vector<HeapItem>, decltype(greater)> heap(greater);
+        auto advance = [&](size_t i) {
+            string line;
+            while (getline(*inputs[i], line)) {
+                if (parseUserLine(line, heads[i])) {
+                    heap.push({ encodeSortKey(heads[i], keys), i });
+                    return;
+                }
+            }
+        };
+        for (size_t i = 0; i < runs.size(); ++i) {
+            inputs.emplace_back(new ifstream(runs[i], ios::binary));
+            advance(i);
+        }
+        while (!heap.empty()) {
+            size_t i = heap.top().second;
+            heap.pop();
+            const User& u = heads[i];
+            printRow(out, u.id, u.familiya, u.imya, u.otchestvo, u.godrozh, u.adres, u.mesto);
+            advance(i);
+        }
+        out.close();
+        if (!out) failed = true;
+    }
+    for (const auto& run_name : runs) remove(run_name.c_str());
+    if (failed) {
+        cerr << u8"Ошибка записи файла: " << target << endl;
+        remove(target.c_str());
+        return -1;
+    }
+    return count;
+}
+
+bool parseImportLine(const string& line, User& u, string& error) {
+    vector<string> fields;
+    stringstream ss(line);
+    string field;
+    while (getline(ss, field, ';')) fields.push_back(trim(field));
+    if (fields.size() != 6) {
+        error = u8"ожидается 6 полей, разделенных ';'";
+        return false;
+    }
+    u.familiya = fields[0];
+    u.imya = fields[1];
+    u.otchestvo = fields[2];
+    u.mesto = fields[5];
+    if (!isCorrectSecondname(u.familiya) || !firstTrue(u.familiya)) {
+        error = u8"некорректная фамилия";
+        return false;
+    }
+    if (!isRussianLettersOnly(u.imya) || !firstTrue(u.imya)) {
+        error = u8"некорректное имя";
+        return false;
+    }
+    if (!isRussianLettersOnly(u.otchestvo) || !firstTrue(u.otchestvo)) {
+        error = u8"некорректное отчество";
+        return false;
+    }
+    if (!isDigitsOnly(fields[3]) || fields[3].length() != 4 || stoi(fields[3]) < 1930 || stoi(fields[3]) > 2007) {
+        error = u8"год рождения должен быть от 1930 до 2007";
+        return false;
+    }
+    u.godrozh = stoi(fields[3]);
+    if (!firstTrue(fields[4]) || !normalizeAddress(fields[4], u.adres)) {
+        error = u8"неверный формат адреса";
+        return false;
+    }
+    if (!isRussianLettersOnly(u.mesto) || !firstTrue(u.mesto)) {
+        error = u8"некорректное место рождения";
+        return false;
+    }
+    return true;
+}
+
+// Результат разбора одного фрагмента файла импорта
+struct ImportChunk {
+    vector<User> users;                 // Прошедшие проверку записи в порядке следования в файле
+    vector<pair<int, string>> errors;   // Номер строки внутри фрагмента и описание ошибки
+    int lines = 0;                      // Количество строк во фрагменте
+    bool ready = false;
+};
+
+bool importVoters(sqlite3* db, const string& filename) {
+    PROFILE_SCOPE(ProfileLoader);
+    const streamoff chunk_size = 4 << 20;
+    ifstream probe(filename, ios::binary | ios::ate);
+    if (!probe) {
+        cout << u8"Ошибка открытия файла: " << filename << endl;
+        return false;
+    }
+    streamoff size = probe.tellg();
+    vector<streamoff> bounds = { 0 };
+    while (bounds.back() < size) {
+        streamoff pos = bounds.back() + chunk_size;
+        if (pos < size) {
+            string rest;
+            probe.seekg(pos);
+            getline(probe, rest);
+            pos = probe ? static_cast<streamoff>(probe.tellg()) : size;
+            probe.clear();
+        }
+        bounds.push_back(pos < size ? pos : size);
+    }
+    probe.close();
+
+    size_t chunk_count = bounds.size() - 1;
+    unsigned workers = thread::hardware_concurrency();
+    if (workers == 0) workers = 1;
+    size_t max_inflight = workers * 2;
+
+    vector<ImportChunk> chunks(chunk_count);
+    mutex m;
+    condition_variable cv;
+    size_t next_chunk = 0, written = 0;
+
+    auto worker = [&]() {
+        PROFILE_SCOPE(ProfileLoader);
+        ifstream in(filename, ios::binary);
+        string buffer;
+        while (true) {
+            size_t k;
+            {
+                unique_lock<mutex> lock(m);
+                cv.wait(lock, [&] { return next_chunk >= chunk_count || next_chunk < written + max_inflight; });
+                if (next_chunk >= chunk_count) return;
+                k = next_chunk++;
+            }
+            buffer.resize(static_cast<size_t>(bounds[k + 1] - bounds[k]));
+            in.seekg(bounds[k]);
+            in.read(&buffer[0], buffer.size());
+
+            ImportChunk chunk;
+            size_t start = 0;
+            if (k == 0 && buffer.compare(0, 3, "\xEF\xBB\xBF") == 0) start = 3;
+            while (start < buffer.size()) {
+                size_t end = buffer.find('\n', start);
+                if (end == string::npos) end = buffer.size();
+                string line = buffer.substr(start, end - start);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                start = end + 1;
+                ++chunk.lines;
+                if (trim(line).empty()) continue;
+                User u;
+                string error;
+                if (parseImportLine(line, u, error)) chunk.users.push_back(move(u));
+                else chunk.errors.push_back({ chunk.lines, error });
+            }
+            {
+                lock_guard<mutex> lock(m);
+                chunks[k] = move(chunk);
+                chunks[k].ready = true;
+            }
+            cv.notify_all();
+        }
+    };
+
+    vector<thread> pool;
+    for (unsigned i = 0; i < workers; ++i) pool.emplace_back(worker);
+
+    SQLiteStmt insert(db, "INSERT INTO users (familiya, imya, otchestvo, godrozh, adres, mesto) VALUES (?, ?, ?, ?, ?, ?);");
+    int added = 0, failed = 0, line_base = 0;
+    vector<pair<int, string>> errors;
+    for (size_t k = 0; k < chunk_count; ++k) {
+        ImportChunk chunk;
+        {
+            unique_lock<mutex> lock(m);
+            cv.wait(lock, [&] { return chunks[k].ready; });
+            chunk = move(chunks[k]);
+            chunks[k] = ImportChunk();
+            written = k + 1;
+        }
+        cv.notify_all();
+
+        // Точка сохранения работает и как отдельная транзакция, и внутри транзакции пакетного режима
+        sqlite3_exec(db, "SAVEPOINT import_chunk;", nullptr, nullptr, nullptr);
+        for (const auto& u : chunk.users) {
+            sqlite3_bind_text(insert.get(), 1, u.familiya.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(insert.get(), 2, u.imya.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(insert.get(), 3, u.otchestvo.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_int(insert.get(), 4, u.godrozh);
+            sqlite3_bind_text(insert.get(), 5, u.adres.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(insert.get(), 6, u.mesto.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(insert.get()) == SQLITE_DONE) ++added;
+            else ++failed;
+            sqlite3_reset(insert.get());
+        }
+        sqlite3_exec(db, "RELEASE import_chunk;", nullptr, nullptr, nullptr);
+
+        for (const auto& e : chunk.errors) {
+            errors.push_back({ line_base + e.first, e.second });
+        }
+        line_base += chunk.lines;
+        cout << u8"\rОбработано строк: " << line_base << flush;
+    }
+    for (auto& t : pool) t.join();
+    syncStats(db);
+    syncBitmaps(db);
+
+    cout << u8"\nДобавлено избирателей: " << added << endl;
+    if (failed > 0) {
+        cerr << u8"Ошибка добавления данных: " << sqlite3_errmsg(db) << u8" (записей: " << failed << ")" << endl;
+    }
+    if (!errors.empty()) {
+        cout << u8"Пропущено строк с ошибками: " << errors.size() << endl;
+        for (size_t i = 0; i < errors.size() && i < 20; ++i) {
+            cout << u8"  строка " << errors[i].first << ": " << errors[i].second << endl;
+        }
+    }
+    return failed == 0;
+}
+
+void generateVoters(sqlite3* db, int count, unsigned seed) {
+    const char* familii[] = { u8"Иванов", u8"Петров", u8"Сидоров", u8"Смирнов", u8"Кузнецов",
+        u8"Попов", u8"Васильев", u8"Соколов", u8"Михайлов", u8"Новиков" };
+    const char* imena[] = { u8"Иван", u8"Петр", u8"Сергей", u8"Алексей", u8"Анна", u8"Мария", u8"Ольга", u8"Елена" };
+    const char* otchestva[] = { u8"Иванович", u8"Петрович", u8"Сергеевич", u8"Алексеевич" };
+    const char* ulicy[] = { u8"Ленина", u8"Мира", u8"Садовая", u8"Новая", u8"Лесная" };
+    const char* goroda[] = { u8"Москва", u8"Тула", u8"Казань", u8"Самара", u8"Пермь" };
+    mt19937 rng(seed);
+    sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+    SQLiteStmt insert(db, "INSERT INTO users (familiya, imya, otchestvo, godrozh, adres, mesto) VALUES (?, ?, ?, ?, ?, ?);");
+    for (int i = 0; i < count; ++i) {
+        string adres = string(u8"Ул. ") + ulicy[rng() % 5] + u8", д. " + to_string(1 + rng() % 50) + u8", кв. " + to_string(1 + rng() % 100);
+        sqlite3_bind_text(insert.get(), 1, familii[rng() % 10], -1, SQLITE_STATIC);
+        sqlite3_bind_text(insert.get(), 2, imena[rng() % 8], -1, SQLITE_STATIC);
+        sqlite3_bind_text(insert.get(), 3, otchestva[rng() % 4], -1, SQLITE_STATIC);
+        sqlite3_bind_int(insert.get(), 4, 1940 + rng() % 66);
+        sqlite3_bind_text(insert.get(), 5, adres.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(insert.get(), 6, goroda[rng() % 5], -1, SQLITE_STATIC);
+        sqlite3_step(insert.get());
+        sqlite3_reset(insert.get());
+    }
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+}
+
+string prefixSuccessor(string prefix) {
+    while (!prefix.empty() && static_cast<unsigned char>(prefix.back()) == 0xFF) prefix.pop_back();
+    if (!prefix.empty()) prefix.back() = static_cast<char>(static_cast<unsigned char>(prefix.back()) + 1);
+    return prefix;
+}
+
+string capitalizeFirst(string str) {
+    if (str.size() < 2) return str;
+    unsigned char c = str[0], next = str[1];
+    if (c == 0xD0 && next >= 0xB0 && next <= 0xBF) {
+        str[1] = static_cast<char>(next - 0x20);
+    }
+    else if (c == 0xD1 && next >= 0x80 && next <= 0x8F) {
+        str[0] = static_cast<char>(0xD0);
+        str[1] = static_cast<char>(next + 0x20);
+    }
+    else if (c == 0xD1 && next == 0x91) {
+        str[0] = static_cast<char>(0xD0);
+        str[1] = static_cast<char>(0x81);
+    }
+    return str;
+}
+
+// Деревья автодополнения для открытой базы данных. Строятся по всей таблице
+// при первом обращении, затем к ним применяются изменения из журнала.
+struct PrefixCache {
+    string db_name;
+    long long position = -1;
+    NameTrie familiya, imya;
+} prefix_cache;
+
+const NameTrie& prefixTrie(sqlite3* db, int field) {
+    string db_name = sqlite3_db_filename(db, "main") ? sqlite3_db_filename(db, "main") : "";
+    bool fresh = prefix_cache.db_name == db_name && replayJournal(db, prefix_cache.position, [](const User& u, bool inserted) {
+        prefix_cache.familiya.add(u.familiya, inserted ? 1 : -1);
+        prefix_cache.imya.add(u.imya, inserted ? 1 : -1);
+        });
+    if (!fresh) {
+        prefix_cache.db_name = db_name;
+        prefix_cache.familiya.clear();
+        prefix_cache.imya.clear();
+        // Позиция и таблица читаются из одного снимка
+        bool own = sqlite3_get_autocommit(db) != 0;
+        if (own) sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+        prefix_cache.position = journalPosition(db);
+        SQLiteStmt fam(db, "SELECT familiya, COUNT(*) FROM users GROUP BY familiya;");
+        while (sqlite3_step(fam.get()) == SQLITE_ROW) {
+            prefix_cache.familiya.add(columnText(fam.get(), 0), sqlite3_column_int64(fam.get(), 1));
+        }
+        SQLiteStmt im(db, "SELECT imya, COUNT(*) FROM users GROUP BY imya;");
+        while (sqlite3_step(im.get()) == SQLITE_ROW) {
+            prefix_cache.imya.add(columnText(im.get(), 0), sqlite3_column_int64(im.get(), 1));
+        }
+        if (own) sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+    }
+    holdJournalInMemory("prefix", db_name, prefix_cache.position);
+    return field == 0 ? prefix_cache.familiya : prefix_cache.imya;
+}
+
+int NameTrie::child(int node, unsigned char c) const {
+    for (const auto& ch : nodes[node].children) {
+        if (ch.first == c) return ch.second;
+    }
+    return -1;
+}
+
+void NameTrie::collect(int node, string& name, size_t limit, vector<pair<string, int64_t>>& out) const {
+    if (out.size() >= limit) return;
+    if (nodes[node].subtotal <= 0) return;     // Все записи ветви удалены
+    if (nodes[node].count > 0) out.push_back({ name, nodes[node].count });
+    for (const auto& ch : nodes[node].children) {
+        name.push_back(static_cast<char>(ch.first));
+        collect(ch.second, name, limit, out);
+        name.pop_back();
+        if (out.size() >= limit) return;
+    }
+}
+
+void NameTrie::add(const string& name, int64_t count) {
+    int node = 0;
+    nodes[0].subtotal += count;
+    for (unsigned char c : name) {
+        int next = child(node, c);
+        if (next < 0) {
+            next = static_cast<int>(nodes.size());
+            nodes.push_back(Node());
+            auto& children = nodes[node].children;
+            auto pos = lower_bound(children.begin(), children.end(), make_pair(c, 0));
+            children.insert(pos, { c, next });
+        }
+        node = next;
+        nodes[node].subtotal += count;
+    }
+    nodes[node].count += count;
+}
+
+int64_t NameTrie::countPrefix(const string& prefix) const {
+    int node = 0;
+    for (unsigned char c : prefix) {
+        node = child(node, c);
+        if (node < 0) return 0;
+    }
+    return nodes[node].subtotal;
+}
+
+vector<pair<string, int64_t>> NameTrie::complete(const string& prefix, size_t limit) const {
+    vector<pair<string, int64_t>> out;
+    int node = 0;
+    for (unsigned char c : prefix) {
+        node = child(node, c);
+        if (node < 0) return out;
+    }
+    string name = prefix;
+    collect(node, name, limit, out);
+    return out;
+}
+
+u32string normalizeName(const string& str) {
+    u32string out;
+    for (size_t i = 0; i < str.size(); ) {
+        unsigned char c = str[i];
+        char32_t cp;
+        if (c < 0x80) {
+            cp = c;
+            i += 1;
+        }
+        else if ((c & 0xE0) == 0xC0 && i + 1 < str.size()) {
+            cp = ((c & 0x1F) << 6) | (static_cast<unsigned char>(str[i + 1]) & 0x3F);
+            i += 2;
+        }
+        else if ((c & 0xF0) == 0xE0 && i + 2 < str.size()) {
+            cp = ((c & 0x0F) << 12) | ((static_cast<unsigned char>(str[i + 1]) & 0x3F) << 6)
+                | (static_cast<unsigned char>(str[i + 2]) & 0x3F);
+            i += 3;
+        }
+        else {
+            cp = c;
+            i += 1;
+        }
+        if (cp >= 0x410 && cp <= 0x42F) cp += 0x20;
+        if (cp == 0x401 || cp == 0x451) cp = 0x435;
+        out.push_back(cp);
+    }
+    return out;
+}
+
+int boundedEditDistance(const u32string& a, const u32string& b, int limit) {
+    int diff = static_cast<int>(a.size()) - static_cast<int>(b.size());
+    if (diff > limit || -diff > limit) return limit + 1;
+    vector<int> prev(b.size() + 1), cur(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); ++j) prev[j] = static_cast<int>(j);
+    for (size_t i = 1; i <= a.size(); ++i) {
+        cur[0] = static_cast<int>(i);
+        int row_min = cur[0];
+        for (size_t j = 1; j <= b.size(); ++j) {
+            int best = prev[j - 1] + (a[i - 1] == b[j - 1] ? 0 : 1);
+            if (prev[j] + 1 < best) best = prev[j] + 1;
+            if (cur[j - 1] + 1 < best) best = cur[j - 1] + 1;
+            cur[j] = best;
+            if (best < row_min) row_min = best;
+        }
+        if (row_min > limit) return limit + 1;
+        prev.swap(cur);
+    }
+    return prev[b.size()] > limit ? limit + 1 : prev[b.size()];
+}
+
+FuzzyCache fuzzy_cache;
+
+const FuzzyCache& fuzzyIndex(sqlite3* db) {
+    string db_name = sqlite3_db_filename(db, "main") ? sqlite3_db_filename(db, "main") : "";
+    bool fresh = fuzzy_cache.db_name == db_name && replayJournal(db, fuzzy_cache.position, [](const User& u, bool inserted) {
+        fuzzy_cache.fields[0].add(u.familiya, inserted ? 1 : -1);
+        fuzzy_cache.fields[1].add(u.imya, inserted ? 1 : -1);
+        fuzzy_cache.fields[2].add(u.otchestvo, inserted ? 1 : -1);
+        });
+    if (!fresh) {
+        fuzzy_cache.db_name = db_name;
+        bool own = sqlite3_get_autocommit(db) != 0;
+        if (own) sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+        fuzzy_cache.position = journalPosition(db);
+        for (int f = 0; f < 3; ++f) {
+            fuzzy_cache.fields[f].clear();
+            SQLiteStmt stmt(db, "SELECT " + sort_columns[f] + ", COUNT(*) FROM users GROUP BY " + sort_columns[f] + ";");
+            while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                fuzzy_cache.fields[f].add(columnText(stmt.get(), 0), sqlite3_column_int64(stmt.get(), 1));
+            }
+        }
+        if (own) sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+    }
+    holdJournalInMemory("fuzzy", db_name, fuzzy_cache.position);
+    return fuzzy_cache;
+}
+
+vector<uint64_t> TrigramIndex::trigrams(const u32string& word) {
+    u32string padded = U"  " + word + U" ";
+    vector<uint64_t> out;
+    for (size_t i = 0; i + 3 <= padded.size(); ++i) {
+        out.push_back((static_cast<uint64_t>(padded[i]) << 42) | (static_cast<uint64_t>(padded[i + 1]) << 21) | padded[i + 2]);
+    }
+    sort(out.begin(), out.end());
+    out.erase(unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+void TrigramIndex::clear() {
+    values.clear();
+    normalized.clear();
+    counts.clear();
+    ids.clear();
+    postings.clear();
+}
+
+void TrigramIndex::add(const string& value, int64_t count) {
+    auto it = ids.find(value);
+    if (it != ids.end()) {
+        counts[it->second] += count;
+        return;
+    }
+    int id = static_cast<int>(values.size());
+    ids[value] = id;
+    values.push_back(value);
+    normalized.push_back(normalizeName(value));
+    counts.push_back(count);
+    for (uint64_t t : trigrams(normalized.back())) {
+        postings[t].push_back(id);
+    }
+}
+
+vector<pair<string, int>> TrigramIndex::search(const string& query, size_t limit) const {
+    u32string q = normalizeName(query);
+    int max_distance = q.size() <= 4 ? 1 : 2;
+    vector<uint64_t> grams = trigrams(q);
+    int threshold = static_cast<int>(grams.size()) - 3 * max_distance;
+    if (threshold < 1) threshold = 1;
+
+    unordered_map<int, int> shared;
+    for (uint64_t t : grams) {
+        auto it = postings.find(t);
+        if (it == postings.end()) continue;
+        for (int id : it->second) ++shared[id];
+    }
+    vector<pair<string, int>> result;
+    for (const auto& c : shared) {
+        if (c.second < threshold || counts[c.first] <= 0) continue;
+        int d = boundedEditDistance(q, normalized[c.first], max_distance);
+        if (d <= max_distance) result.push_back({ values[c.first], d });
+    }
+    sort(result.begin(), result.end(), [](const pair<string, int>& a, const pair<string, int>& b) {
+        return a.second != b.second ? a.second < b.second : a.first < b.first;
+        });
+    if (result.size() > limit) result.resize(limit);
+    return result;
+}
+
+int compareNaturalKey(const User& a, const User& b) {
+    int c = a.familiya.compare(b.familiya);
+    if (c != 0) return c;
+    c = a.imya.compare(b.imya);
+    if (c != 0) return c;
+    c = a.otchestvo.compare(b.otchestvo);
+    if (c != 0) return c;
+    return a.godrozh < b.godrozh ? -1 : (a.godrozh > b.godrozh ? 1 : 0);
+}
+
+void writeUsers(const string& filename, const vector<User>& users, FileBatch& batch) {
+    string temp = FileBatch::tempName(filename);
+    ofstream file(temp, ios::trunc);
+    if (!file) {
+        cerr << u8"Не удалось открыть файл: " << filename << endl;
+        return;
+    }
+    printTableHeader(file);
+    for (const auto& u : users) {
+        printRow(file, u.id, u.familiya, u.imya, u.otchestvo, u.godrozh, u.adres, u.mesto);
+    }
+    file.close();
+    if (!file) {
+        cerr << u8"Ошибка записи файла: " << filename << endl;
+        remove(temp.c_str());
+        return;
+    }
+    batch.add(filename);
+}
+
+string partitionKey(int by, const User& u) {
+    if (by == 1) return u.mesto;
+    if (by == 2) return to_string(u.godrozh / 10 * 10);
+    return streetOf(u.adres);
+}
+
+RoaringBitmap bitmapTerm(int field, const string& value) {
+    RoaringBitmap result;
+    if (field == 1) {
+        size_t dash = value.find('-');
+        int from = stoi(value.substr(0, dash));
+        int to = dash == string::npos ? from : stoi(value.substr(dash + 1));
+        for (auto it = bitmap_index.years.lower_bound(from); it != bitmap_index.years.end() && it->first <= to; ++it) {
+            result = RoaringBitmap::unite(result, it->second);
+        }
+        return result;
+    }
+    const auto& index = field == 2 ? bitmap_index.cities : bitmap_index.streets;
+    auto it = index.find(value);
+    if (it != index.end()) result = it->second;
+    return result;
+}
+
+void loadFilterIds(sqlite3* db, const RoaringBitmap& ids) {
+    sqlite3_exec(db, "CREATE TEMP TABLE IF NOT EXISTS filter_ids (id INTEGER PRIMARY KEY); DELETE FROM filter_ids; BEGIN;",
+        nullptr, nullptr, nullptr);
+    {
+        SQLiteStmt insert(db, "INSERT INTO filter_ids (id) VALUES (?);");
+        for (uint32_t id : ids.values()) {
+            sqlite3_bind_int64(insert.get(), 1, id);
+            sqlite3_step(insert.get());
+            sqlite3_reset(insert.get());
+        }
+    }
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+}
+
+string initialOf(const string& str) {
+    if (str.empty()) return str;
+    size_t len = 1;
+    while (len < str.size() && (static_cast<unsigned char>(str[len]) & 0xC0) == 0x80) ++len;
+    return str.substr(0, len) + ".";
+}
+
+bool setStorageProfile(sqlite3* db, const StorageProfile& p) {
+    if (sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS settings (name TEXT PRIMARY KEY, value TEXT NOT NULL);",
+        nullptr, nullptr, nullptr) != SQLITE_OK) {
+        cerr << u8"Ошибка SQLite: " << sqlite3_errmsg(db) << endl;
+        return false;
+    }
+    SQLiteStmt stmt(db, "INSERT OR REPLACE INTO settings (name, value) VALUES ('storage_profile', ?);");
+    sqlite3_bind_text(stmt.get(), 1, p.name, -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt.get()) != SQLITE_DONE) {
+        cerr << u8"Ошибка SQLite: " << sqlite3_errmsg(db) << endl;
+        return false;
+    }
+    return applyStorageProfile(db, p, true);
+}
+
+bool isValidDate(const string& date) {
+    if (date.length() != 10 || date[2] != '.' || date[5] != '.') return false;
+    string day = date.substr(0, 2), month = date.substr(3, 2), year = date.substr(6);
+    if (!isDigitsOnly(day) || !isDigitsOnly(month) || !isDigitsOnly(year)) return false;
+    int d = stoi(day), m = stoi(month);
+    return m >= 1 && m <= 12 && d >= 1 && d <= 31;
+}
+
+void writeAgeReport(ostream& out, const string& date, const vector<int>& bounds) {
+    int on_year = stoi(date.substr(6));
+    int64_t total = year_index.total();
+    vector<pair<string, int64_t>> groups;
+    for (size_t i = 0; i <= bounds.size(); ++i) {
+        // Возраст от low до high лет - годы рождения от on_year - high до on_year - low
+        int low = i == 0 ? 0 : bounds[i - 1];
+        int from = i == bounds.size() ? year_index.first_year : on_year - (bounds[i] - 1);
+        int64_t count = year_index.countRange(from, on_year - low);
+        string title = i == 0 ? u8"младше " + to_string(bounds[0])
+            : (i == bounds.size() ? to_string(low) + u8" и старше" : to_string(low) + "-" + to_string(bounds[i] - 1));
+        groups.push_back({ title, count });
+    }
+    int64_t max_count = 1;
+    for (const auto& g : groups) {
+        if (g.second > max_count) max_count = g.second;
+    }
+    out << u8"Возрастной состав избирателей на " << date << u8" (всего: " << total << ")" << endl;
+    out << u8"Возраст      | Число      | Доля, % | " << endl;
+    out << u8"----------------------------------------------------------------------------------" << endl;
+    for (const auto& g : groups) {
+        out << g.first << padding(12, utf8Length(g.first)) << " | " << left << setw(10) << g.second << " | "
+            << right << setw(7) << fixed << setprecision(1) << (total > 0 ? g.second * 100.0 / total : 0.0) << " | "
+            << left << string(static_cast<size_t>(g.second * 50 / max_count), '#') << endl;
+    }
+    out.unsetf(ios::fixed);
+}
+
+vector<string> splitCommand(const string& line) {
+    vector<string> words;
+    string word;
+    bool quoted = false, started = false;
+    for (char c : line) {
+        if (c == '"') {
+            quoted = !quoted;
+            started = true;
+        }
+        else if ((c == ' ' || c == '\t') && !quoted) {
+            if (started) words.push_back(word);
+            word.clear();
+            started = false;
+        }
+        else {
+            word += c;
+            started = true;
+        }
+    }
+    if (started) words.push_back(word);
+    return words;
+}
+
+vector<string> listDatabases(const string& dir) {
+    vector<string> files;
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((dir + "\\*.db").c_str(), &data);
+    if (find != INVALID_HANDLE_VALUE) {
+        do {
+            if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) files.push_back(dir + "\\" + data.cFileName);
+        } while (FindNextFileA(find, &data));
+        FindClose(find);
+    }
+#else
+    DIR* d = opendir(dir.c_str());
+    if (d) {
+        while (dirent* entry = readdir(d)) {
+            string name = entry->d_name;
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, ".db") == 0) files.push_back(dir + "/" + name);
+        }
+        closedir(d);
+    }
+#endif
+    sort(files.begin(), files.end());
+    return files;
+}
+
+bool openSource(const string& file, const string& sql, const vector<string>& params,
+    sqlite3*& db, sqlite3_stmt*& stmt, string& error) {
+    db = nullptr;
+    stmt = nullptr;
+    if (sqlite3_open_v2(file.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK ||
+        sqlite3_busy_timeout(db, 5000) != SQLITE_OK ||
+        sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        error = sqlite3_errmsg(db);
+        return false;
+    }
+    for (size_t i = 0; i < params.size(); ++i) {
+        sqlite3_bind_text(stmt, static_cast<int>(i) + 1, params[i].c_str(), -1, SQLITE_TRANSIENT);
+    }
+    return true;
+}
+
+void querySource(SourceResult& source, const string& sql, const vector<string>& params) {
+    auto started = chrono::steady_clock::now();
+    sqlite3* db;
+    sqlite3_stmt* stmt;
+    if (openSource(source.file, sql, params, db, stmt, source.error)) {
+        int rc = sqlite3_step(stmt);
+        if (rc == SQLITE_ROW) source.count = sqlite3_column_int64(stmt, 0);
+        else source.error = sqlite3_errmsg(db);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    source.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+}
+
+long long writeMerged(ostream& out, const vector<SourceResult>& sources, const string& sql,
+    const vector<string>& params, int name_width) {
+    ostringstream header;
+    printTableHeader(header);
+    string line;
+    istringstream caption(header.str());
+    getline(caption, line);
+    out << u8"База данных" << padding(name_width, 11) << " | " << line << endl;
+    getline(caption, line);
+    out << string(name_width + 3, '-') << line << endl;
+
+    // Открытый запрос к каждой базе и его текущая строка
+    struct Stream {
+        sqlite3* db = nullptr;
+        sqlite3_stmt* stmt = nullptr;
+        User row;
+    };
+    vector<Stream> streams(sources.size());
+    auto advance = [&](size_t i) {
+        Stream& s = streams[i];
+        int rc = sqlite3_step(s.stmt);
+        if (rc == SQLITE_ROW) {
+            s.row.id = sqlite3_column_int(s.stmt, 0);
+            readUserColumns(s.stmt, 1, s.row);
+            return true;
+        }
+        if (rc != SQLITE_DONE) cerr << u8"Ошибка чтения базы данных " << sources[i].name << ": " << sqlite3_errmsg(s.db) << endl;
+        return false;
+    };
+
+    // Элемент кучи - номер базы; сравниваются текущие строки баз
+    auto later = [&](size_t a, size_t b) {
+        const User& x = streams[a].row;
+        const User& y = streams[b].row;
+        int c = compareNaturalKey(x, y);
+        if (c != 0) return c > 0;
+        if (a != b) return a > b;
+        return x.id > y.id;
+    };
+    priority_queue<size_t, vector<size_t>, decltype(later)> heap(later);
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (!sources[i].error.empty()) continue;
+        string error;
+        if (!openSource(sources[i].file, sql, params, streams[i].db, streams[i].stmt, error)) {
+            cerr << u8"Ошибка чтения базы данных " << sources[i].name << ": " << error << endl;
+            continue;
+        }
+        if (advance(i)) heap.push(i);
+    }
+    long long count = 0;
+    while (!heap.empty()) {
+        size_t top = heap.top();
+        heap.pop();
+        const SourceResult& source = sources[top];
+        const User& u = streams[top].row;
+        out << source.name << padding(name_width, utf8Length(source.name)) << " | ";
+        printRow(out, u.id, u.familiya, u.imya, u.otchestvo, u.godrozh, u.adres, u.mesto);
+        ++count;
+        if (advance(top)) heap.push(top);
+    }
+    for (auto& s : streams) {
+        sqlite3_finalize(s.stmt);
+        sqlite3_close(s.db);
+    }
+    return count;
+}
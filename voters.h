@@ -0,0 +1,1054 @@
+// Ядро программы учета избирателей: обертки SQLite, проверка ввода, вывод таблиц,
+// загрузка и сортировка файлов, отчеты и индексы.
+// Не зависит от консоли (см. terminal.h) и платформы; используется программой,
+// пакетным режимом и замерами производительности.
+#pragma once
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <set>
+#include <map>
+#include <deque>
+#include <atomic>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <functional>
+#include <queue>
+#include <sqlite3.h>
+
+
+// Профилирование памяти (включается при сборке с флагом VOTERS_PROFILE).
+// Глобальные operator new/delete ведут счетчики выделений по подсистемам;
+// подсистема текущего потока задается областью PROFILE_SCOPE. После каждого
+// действия меню выводится сводка вместе с пиковым RSS процесса и памятью SQLite.
+#ifdef VOTERS_PROFILE
+enum ProfileSubsystem { ProfileOther, ProfileLoader, ProfileSort, ProfileRender, ProfileExport, ProfileCount };
+
+struct ProfileCounters {
+    std::atomic<long long> allocations{ 0 };
+    std::atomic<long long> bytes{ 0 };
+    std::atomic<long long> live{ 0 };
+    std::atomic<long long> peak{ 0 };
+};
+extern ProfileCounters profile_counters[ProfileCount];
+
+extern thread_local int profile_subsystem;
+
+// Смена подсистемы текущего потока на время области видимости
+class ProfileScope {
+    int previous;
+public:
+    explicit ProfileScope(int subsystem) : previous(profile_subsystem) { profile_subsystem = subsystem; }
+    ~ProfileScope() { profile_subsystem = previous; }
+};
+#define PROFILE_JOIN(a, b) a##b
+#define PROFILE_NAME(line) PROFILE_JOIN(profile_scope_, line)
+#define PROFILE_SCOPE(subsystem) ProfileScope PROFILE_NAME(__LINE__)(subsystem)
+
+// Пиковый объем физической памяти процесса в байтах
+long long peakResidentBytes();
+
+// Сводка по памяти за последнее действие меню; счетчики после вывода обнуляются
+void profileReport();
+#else
+#define PROFILE_SCOPE(subsystem)
+#endif
+
+// Структура для хранения данных пользователя
+struct User {
+    int id;
+    std::string familiya, imya, otchestvo;
+    int godrozh;
+    std::string adres, mesto;
+};
+
+// Профиль хранения: параметры ввода-вывода SQLite для разных сценариев работы.
+// Выбранный профиль хранится в таблице settings самой базы данных
+// и применяется при каждом открытии подключения.
+struct StorageProfile {
+    const char* name;
+    const char* title;
+    long long mmap_size;      // Размер отображения файла в память, байт
+    int cache_size;           // Кеш страниц (отрицательное значение - в КБ)
+    int page_size;            // Размер страницы; меняется только через VACUUM
+    const char* temp_store;
+    const char* journal_mode;
+    const char* synchronous;
+};
+
+// Предопределенные профили хранения (первый - стандартный)
+const int storage_profile_count = 4;
+extern const StorageProfile storage_profiles[storage_profile_count];
+
+// Профиль по имени (стандартный, если имя неизвестно)
+const StorageProfile& findStorageProfile(const std::string& name);
+
+// Имя профиля, сохраненного в базе данных
+std::string storedProfileName(sqlite3* db);
+
+// Применение профиля к подключению. Размер страницы меняется только
+// по запросу (change_page_size), так как для этого база перестраивается VACUUM.
+bool applyStorageProfile(sqlite3* db, const StorageProfile& p, bool change_page_size);
+
+// Проверка, что база данных работает с журналом WAL (чтение не блокирует запись)
+bool walMode(sqlite3* db);
+
+// Класс для управления подключением к базе данных SQLite
+class SQLiteDB {
+    sqlite3* db;
+public:
+    SQLiteDB(const std::string& name);
+    ~SQLiteDB() { sqlite3_close(db); }
+    sqlite3* get() const { return db; }
+};
+
+// Класс для управления подготовленным запросом SQLite
+class SQLiteStmt {
+    sqlite3_stmt* stmt;
+public:
+    SQLiteStmt(sqlite3* db, const std::string& sql);
+    ~SQLiteStmt() { sqlite3_finalize(stmt); }
+    sqlite3_stmt* get() const { return stmt; }
+};
+
+// Проверка, что строка содержит только русские буквы
+bool isRussianLettersOnly(const std::string& str);
+
+bool firstTrue(const std::string& str);
+
+// Проверка, что фамилия содержит русский буквы и дефис
+bool isCorrectSecondname(const std::string& str);
+
+// Проверка, что строка содержит только цифры
+bool isDigitsOnly(const std::string& str);
+
+// Проверка, что строка является корректным именем файла
+bool isValidFilename(const std::string& str);
+
+// Приведение адреса вида "Ленина 64 5" к виду "Ул. Ленина, д. 64, кв. 5"
+bool normalizeAddress(const std::string& raw, std::string& adres);
+
+// Вывод заголовка таблицы в файл
+void printTableHeader(std::ostream& out);
+
+// Пробелы для дополнения значения длиной len символов до ширины столбца.
+// Значения длиннее столбца выводятся целиком без дополнения.
+std::string padding(int width, int len);
+
+// Вывод строки данных в файл
+void printRow(std::ostream& out, int id, const std::string& familiya, const std::string& imya, const std::string& otchestvo, int godrozh, const std::string& adres, const std::string& mesto);
+
+// Функция очистки строки от пробелов
+std::string trim(const std::string& str);
+
+// Разбор строки файла отчета в структуру пользователя.
+// Поля разделены символом '|'; строка разбирается за один проход.
+bool parseUserLine(const std::string& line, User& u);
+
+// Проверка, является ли строка файла отчета заголовком или разделителем
+bool isHeaderLine(const std::string& line);
+
+// Потоковая обработка файла отчета: строки читаются по одной, проходят через
+// фильтры и преобразования в порядке их добавления и сразу передаются получателю.
+// В памяти находится только текущая строка и буфер чтения, поэтому объем
+// используемой памяти не зависит от размера файла.
+class ReportPipeline {
+public:
+    typedef std::function<bool(const User&)> Predicate;
+    typedef std::function<void(User&)> Transform;
+    typedef std::function<void(const User&)> Sink;
+
+    explicit ReportPipeline(const std::string& filename) : filename(filename) {}
+
+    ReportPipeline& filter(Predicate predicate);
+    ReportPipeline& map(Transform transform);
+
+    // Выполнение конвейера; возвращает число строк, дошедших до получателя,
+    // или -1, если файл не удалось открыть
+    long long run(const Sink& sink) const;
+
+private:
+    std::string filename;
+    std::vector<std::pair<Predicate, Transform>> stages;
+};
+
+// Структура для описания одного столбца сортировки
+struct SortKey {
+    int field;       // Номер поля (0 - фамилия, 1 - имя, 2 - отчество, 3 - год рождения, 4 - адрес, 5 - место)
+    bool ascending;  // true - по возрастанию, false - по убыванию
+};
+
+// Названия столбцов таблицы users в порядке номеров полей
+extern const std::string sort_columns[6];
+
+// Построение выражения ORDER BY по списку столбцов (ID в конце делает порядок однозначным)
+std::string orderByClause(const std::vector<SortKey>& keys);
+
+// Кодирование составного ключа сортировки в байтовую строку, сравниваемую через memcmp.
+// Строки записываются как есть с завершающим нулём, год - 4 байтами big-endian,
+// для убывающих столбцов байты инвертируются.
+std::string encodeSortKey(const User& u, const std::vector<SortKey>& keys);
+
+// Сравнение закодированных ключей как беззнаковых байтовых строк
+bool sortKeyLess(const std::string& a, const std::string& b);
+
+// Устойчивая сортировка пользователей по нескольким столбцам через заранее вычисленные ключи
+void sortUsers(std::vector<User>& users, const std::vector<SortKey>& keys);
+
+// Разбор выражения ORDER BY, сохраненного в реестре отчетов, обратно в список столбцов
+std::vector<SortKey> parseOrderBy(const std::string& clause);
+
+// Ключ строки файла отчета: столбцы сортировки и ID в конце, как в orderByClause
+std::string encodeReportKey(const User& u, const std::vector<SortKey>& keys);
+
+// Создание журнала изменений и реестра файлов отчетов, если их еще нет.
+// Триггеры записывают каждую вставку и удаление в журнал в той же транзакции
+// (изменение записывается как удаление старой версии и вставка новой),
+// поэтому файлы отчетов можно обновлять позже одним пакетом.
+bool ensureJournal(sqlite3* db);
+
+// Создание индексов, используемых поиском (если их еще нет)
+bool ensureIndexes(sqlite3* db);
+
+// Текущая позиция журнала (номер последней записанной операции)
+long long journalPosition(sqlite3* db);
+
+// Удаление из журнала операций, которые уже отражены во всех файлах отчетов,
+// в статистике и в индексах в памяти этого процесса
+void pruneJournal(sqlite3* db);
+
+// Снятие удержаний журнала фоновыми выгрузками (записи "export:<процесс>:<файл>"
+// в stats), процессы которых уже не работают: после аварийного завершения такая
+// запись иначе навсегда запретила бы очистку журнала. Вызывается при открытии базы.
+void clearStaleHolds(sqlite3* db);
+
+// Позиция журнала, до которой догнан индекс в памяти (owner - его название):
+// pruneJournal не удаляет изменения, которые индексу еще предстоит применить
+void holdJournalInMemory(const std::string& owner, const std::string& db_name, long long position);
+
+// Применение к индексу в памяти изменений журнала после position (apply получает
+// пользователя и признак добавления); position сдвигается на последнее изменение.
+// Возвращает false, если часть изменений уже удалена из журнала - тогда индекс
+// нужно построить заново.
+bool replayJournal(sqlite3* db, long long& position, const std::function<void(const User&, bool)>& apply);
+
+// Текст столбца результата запроса (пустая строка для NULL)
+std::string columnText(sqlite3_stmt* stmt, int col);
+
+// Чтение полей пользователя из шести подряд идущих столбцов, начиная с first
+void readUserColumns(sqlite3_stmt* stmt, int first, User& u);
+
+// Точка имитации сбоя для проверки атомарной записи отчетов (--crash-at N):
+// на N-й пройденной точке процесс завершается немедленно, без закрытия файлов
+extern int crash_countdown;
+
+void crashPoint();
+
+// Каталог файла (для сброса записей каталога после переименования)
+std::string directoryOf(const std::string& filename);
+
+// Барьер записи: содержимое файлов сбрасывается на диск. В Linux один вызов
+// syncfs сбрасывает всю файловую систему, поэтому на группу файлов в одном
+// каталоге приходится один барьер; в других системах файлы сбрасываются по одному.
+bool syncFiles(const std::vector<std::string>& names);
+
+// Атомарная замена файла уже записанным временным файлом
+bool replaceFile(const std::string& temp, const std::string& target);
+
+// Идентификатор текущего процесса и проверка, что процесс с данным идентификатором работает
+long long currentProcessId();
+bool processAlive(long long pid);
+
+// Полный путь к файлу (отчеты регистрируются по нему, а не по имени в текущем каталоге)
+std::string absolutePath(const std::string& filename);
+
+// Отметка файла: размер и время последнего изменения в секундах.
+// Возвращает false, если файла нет.
+bool fileStamp(const std::string& filename, long long& size, long long& mtime);
+
+// Установка времени изменения файла, чтобы копия сохраняла отметку оригинала
+void setFileTime(const std::string& filename, long long mtime);
+
+// Усечение файла до заданного размера
+bool truncateFile(const std::string& filename, long long size);
+
+// Отмена изменений файлов вместе с откатом транзакции пакетного режима.
+// Перед первой заменой или изменением файла на месте сохраняется его копия
+// (или отмечается, что файла не было). rollback() возвращает файлы
+// к состоянию на начало транзакции, commit() удаляет копии.
+class FileUndo {
+    std::map<std::string, bool> saved;     // Файл и наличие его копии
+public:
+    static std::string backupName(const std::string& target) { return target + ".undo"; }
+    void save(const std::string& target);
+    void commit();
+    void rollback();
+};
+
+// Журнал отмены открытой транзакции пакетного режима (nullptr - вне транзакции)
+extern FileUndo* file_undo;
+
+// Вызывается перед заменой или изменением файла: сохраняет его в журнале отмены
+void beforeFileChange(const std::string& target);
+
+// Атомарная запись группы файлов. Новое содержимое пишется во временные файлы,
+// commit() одним барьером сбрасывает их на диск и переименовывает поверх старых.
+// После сбоя в любой момент каждый файл остается либо полностью старым, либо
+// полностью новым; недописанный временный файл перезаписывается при следующей записи.
+class FileBatch {
+    std::vector<std::pair<std::string, std::string>> files;     // Временный файл и заменяемый им файл
+public:
+    FileBatch() = default;
+    FileBatch(const FileBatch&) = delete;
+    FileBatch& operator=(const FileBatch&) = delete;
+    ~FileBatch() { discard(); }
+
+    static std::string tempName(const std::string& target) { return target + ".tmp"; }
+
+    // Регистрация полностью записанного временного файла
+    void add(const std::string& target) { add(target, tempName(target)); }
+    void add(const std::string& target, const std::string& temp) { files.push_back({ temp, target }); }
+    bool empty() const { return files.empty(); }
+
+    bool commit();
+    void discard();
+};
+
+// Курсор результата запроса. Строки читаются из SQLite только по мере обхода
+// и декодируются в кольцевой буфер ограниченного размера; строки, вытесненные
+// из буфера, дописываются во временный файл. Повторный обход (например,
+// сохранение в файл после вывода на экран) читает строки из файла и буфера
+// и не выполняет запрос заново. Курсор без повторного обхода (replayable = false)
+// ничего не пишет на диск, а при повторном обходе выполняет запрос еще раз.
+class ResultCursor {
+public:
+    explicit ResultCursor(sqlite3_stmt* stmt, bool replayable = true, size_t capacity = 4096)
+        : stmt(stmt), replayable(replayable), capacity(capacity) {}
+    ~ResultCursor();
+    ResultCursor(const ResultCursor&) = delete;
+    ResultCursor& operator=(const ResultCursor&) = delete;
+
+    sqlite3_stmt* statement() const { return stmt; }
+    bool failed() const { return error; }
+    // Позиция журнала, которой соответствует снимок базы, прочитанный запросом
+    // (определяется при чтении первой строки)
+    long long position() const { return snapshot; }
+
+    // Проверка наличия строк (первая строка читается в буфер)
+    bool empty();
+
+    // Обход строк результата с начала; f возвращает false, чтобы прервать обход.
+    // Возвращает число переданных в f строк.
+    template <typename F>
+    long long forEach(F f) {
+        return traverse(f, [&](sqlite3_stmt*) { return f(ring.back()); }, true);
+    }
+
+    // Обход без копирования новых строк: строки, уже прочитанные из SQLite
+    // (буфер и временный файл), передаются в on_user, а еще не прочитанные -
+    // в on_row, который берет значения прямо из запроса. Курсор без повторного
+    // обхода такие строки не декодирует и не хранит.
+    template <typename U, typename R>
+    long long forEachRaw(U on_user, R on_row) {
+        return traverse(on_user, on_row, replayable);
+    }
+private:
+    sqlite3_stmt* stmt;
+    bool replayable;
+    size_t capacity;
+    std::deque<User> ring;
+    FILE* spill = nullptr;
+    long long spilled = 0;       // Число строк во временном файле
+    bool spill_at_end = true;
+    bool started = false, done = false, error = false;
+    bool lost = false;           // Часть строк вытеснена без сохранения
+    long long snapshot = 0;
+
+    // Общий обход; keep - декодировать новые строки в буфер до вызова on_row
+    // (forEach передает строку из буфера)
+    template <typename U, typename R>
+    long long traverse(U on_user, R on_row, bool keep) {
+        long long count = 0;
+        if (lost) {
+            restart();
+        }
+        else {
+            if (spilled > 0) {
+                fflush(spill);
+                rewind(spill);
+                spill_at_end = false;
+                User u;
+                for (long long i = 0; i < spilled; ++i) {
+                    if (!readSpilled(u)) {
+                        std::cerr << u8"Ошибка чтения временного файла результата" << std::endl;
+                        error = true;
+                        return count;
+                    }
+                    ++count;
+                    if (!on_user(u)) return count;
+                }
+            }
+            for (size_t i = 0; i < ring.size(); ++i) {
+                ++count;
+                if (!on_user(ring[i])) return count;
+            }
+        }
+        while (step()) {
+            ++count;
+            if (keep) {
+                store();
+                if (!on_row(stmt)) return count;
+            }
+            else {
+                // on_row читает значения до декодирования, пока типы столбцов
+                // не изменены преобразованием
+                bool more = on_row(stmt);
+                if (replayable) store();
+                else lost = true;
+                if (!more) return count;
+            }
+        }
+        return count;
+    }
+
+    // Чтение следующей строки из SQLite в конец буфера
+    bool fetch();
+
+    bool step();
+
+    // Декодирование текущей строки запроса в конец буфера с вытеснением старейшей
+    void store();
+
+    void restart();
+
+    // Строка во временном файле: ID и год рождения, затем пять строк с длиной
+    void spillRow(const User& u);
+
+    bool readSpilled(User& u);
+};
+
+// Длина строки UTF-8 в символах
+int utf8Length(const std::string& text);
+
+// Вывод результата запроса в консоль по мере чтения строк
+void print(ResultCursor& rows);
+
+// Запись результата запроса в файл
+bool write(const std::string& f_name, ResultCursor& rows, bool append);
+
+// Отчеты с записями фиксированной длины (.tbl).
+// Каждая запись занимает ровно fixed_record_size байт (ширина полей считается
+// в байтах, а не в символах), записи упорядочены по ID. Первые две строки
+// файла той же длины: счетчики записей и названия столбцов. Поэтому запись
+// с номером i начинается со смещения (i + 2) * fixed_record_size и ищется
+// по ID двоичным поиском, а изменение и удаление выполняются на месте.
+// Удаленная запись остается в файле с пометкой "x" в первом столбце.
+const int fixed_widths[] = { 1, 10, 64, 48, 64, 6, 96, 64 };
+const int fixed_fields = 8;
+const long long fixed_record_size = 1 + 10 + 64 + 48 + 64 + 6 + 96 + 64 + (fixed_fields - 1) * 3 + 1;
+
+// Значение, дополненное пробелами до ширины в байтах; слишком длинное
+// значение обрезается по границе символа UTF-8
+void putFixed(std::string& out, const std::string& value, int width);
+
+// Строка из значений полей фиксированной ширины, разделенных " | "
+std::string fixedLine(const std::string (&fields)[fixed_fields]);
+
+std::string formatFixedRecord(const User& u, bool removed);
+
+// Разбор записи фиксированной длины по смещениям полей
+bool parseFixedRecord(const std::string& record, User& u, bool& removed);
+
+// Открытый файл отчета с записями фиксированной длины
+class FixedReport {
+    std::fstream file;
+    long long records = 0;   // Число записей в файле, включая удаленные
+    long long removed = 0;   // Число записей, помеченных как удаленные
+
+    bool readRecord(long long index, std::string& record);
+    bool writeRecord(long long index, const std::string& record);
+
+public:
+    long long size() const { return records; }
+    long long removedCount() const { return removed; }
+
+    // Создание пустого файла с заголовком
+    bool create(const std::string& filename);
+
+    // Открытие существующего файла. Если изменение на месте было прервано
+    // (заголовок помечен как незавершенный или файл длиннее, чем в нем указано),
+    // дописанные после заголовка записи отбрасываются, а число удаленных
+    // пересчитывается: повторная синхронизация применит журнал заново.
+    bool open(const std::string& filename);
+
+    // Перезапись строки счетчиков (ее длина не меняется). Флаг dirty отмечает,
+    // что файл меняется на месте и счетчики могут не соответствовать записям.
+    bool writeHeader(bool dirty = false);
+
+    // Пометка начала изменения на месте; снимается в close()
+    bool beginUpdate();
+
+    bool read(long long index, User& u, bool& is_removed);
+
+    // Двоичный поиск записи по ID; возвращает номер записи или -1.
+    // Для каждой проверки читается только поле ID.
+    long long find(int id);
+
+    // ID последней записи (0 для пустого файла)
+    int lastId();
+
+    bool update(long long index, const User& u);
+
+    bool remove(long long index);
+
+    // Добавление записи в конец (ID должен быть больше последнего)
+    bool append(const User& u);
+
+    bool close();
+};
+
+// Запись результата запроса в файл с записями фиксированной длины.
+// Если строки идут не по возрастанию ID, строки перечитываются из курсора
+// и сортируются в памяти. Возвращает число записей или -1 при ошибке.
+long long writeFixedReport(const std::string& filename, ResultCursor& rows);
+
+// Применение изменений из журнала к отчету с записями фиксированной длины:
+// удаления и изменения выполняются на месте после двоичного поиска,
+// новые записи с ID больше последнего дописываются в конец. Если новую запись
+// нужно вставить в середину, файл переписывается целиком без удаленных записей
+// во временный файл, который заменит отчет при фиксации группы batch.
+bool applyFixedChanges(const std::string& filename, const std::set<int>& deleted, const std::map<int, User>& inserted, FileBatch& batch);
+
+// Регистрация файла отчета вместе с позицией журнала, которой соответствует его содержимое.
+// Файл хранится по полному пути вместе с отметкой (размер и время изменения).
+void registerReport(sqlite3* db, const std::string& filename, const std::string& kind, const std::string& param, long long position);
+
+// Проверка, должен ли пользователь попасть в отчет данного вида
+// (street - подстрока адреса, street_exact - название улицы целиком, как в секциях)
+bool reportMatches(const std::string& kind, const std::string& param, const User& u);
+
+// Применение накопленных изменений к одному файлу отчета за один потоковый проход.
+// Новые строки сортируются и вливаются в файл слиянием по порядку отчета
+// (для отсортированных отчетов - по их ORDER BY, для поиска по началу - по
+// фамилии или имени, для остальных - по ID),
+// поэтому файл остается упорядоченным без полной пересортировки.
+// Строки, уже присутствующие в файле, повторно не добавляются, поэтому
+// повторное применение после сбоя не создает дубликатов.
+// Новый файл пишется во временный и заменяет отчет при фиксации группы batch.
+bool applyReportChanges(const std::string& filename, const std::string& kind, const std::string& param,
+    const std::set<int>& deleted, const std::map<int, User>& inserted, FileBatch& batch);
+
+// Пакетное обновление зарегистрированных файлов отчетов по журналу изменений.
+// Если указано имя файла, обновляется только он. Все измененные файлы заменяются
+// одной группой с общим барьером записи, и только после этого в таблице reports
+// сдвигаются их позиции: после сбоя изменения просто применяются повторно.
+// Файл, отметка которого не совпадает с сохраненной, переписан извне (например,
+// другой базой данных с тем же именем отчета) и больше не отслеживается.
+// Возвращает число обновленных файлов.
+int syncReports(sqlite3* db, const std::string& only_file);
+
+// Название улицы из нормализованного адреса "Ул. X, д. N, кв. M"
+std::string streetOf(const std::string& adres);
+
+// 64-битный хеш строки (FNV-1a с финальным перемешиванием)
+uint64_t hashString(const std::string& str);
+
+// Вспомогательные функции двоичной сериализации статистики
+void putInt(std::string& out, int64_t v);
+
+int64_t getInt(const std::string& in, size_t& pos);
+
+// Оценка числа различных значений (HyperLogLog, 2^14 регистров, погрешность около 1%).
+// Удаления не поддерживаются: после них оценка становится оценкой сверху до пересчета.
+class HyperLogLog {
+    static const int p = 14;
+    std::string registers;
+public:
+    HyperLogLog() : registers(1 << p, '\0') {}
+    void add(const std::string& value);
+    double estimate() const;
+    void save(std::string& out) const { out += registers; }
+    void load(const std::string& in, size_t& pos);
+};
+
+// Частотный скетч count-min с поддержкой удалений и списком самых частых значений
+class CountMinSketch {
+    static const int depth = 4;
+    static const int width = 2048;
+    static const size_t max_candidates = 32;
+    std::vector<int64_t> counts;
+    std::map<std::string, int64_t> candidates;
+public:
+    CountMinSketch() : counts(depth * width, 0) {}
+    int64_t estimate(const std::string& value) const;
+    void add(const std::string& value, int64_t delta);
+    std::vector<std::pair<std::string, int64_t>> top(size_t n) const;
+    void save(std::string& out) const;
+    void load(const std::string& in, size_t& pos);
+};
+
+// Статистика по избирателям: приближенные счетчики различных значений,
+// частые города и улицы и точная гистограмма по годам рождения
+struct VoterStats {
+    int64_t total = 0;
+    int64_t deletes = 0;   // Число удалений после последнего пересчета (HyperLogLog их не учитывает)
+    HyperLogLog distinct_familiya, distinct_mesto, distinct_street;
+    CountMinSketch top_mesto, top_street;
+    std::map<int, int64_t> years;
+
+    void add(const User& u);
+    void remove(const User& u);
+    std::string save() const;
+    void load(const std::string& in);
+};
+
+// Сохранение статистики в базу вместе с позицией журнала, которой она соответствует
+void saveStats(sqlite3* db, const VoterStats& stats, long long position);
+
+// Полный пересчет статистики по всей таблице users
+VoterStats rebuildStats(sqlite3* db);
+
+// Загрузка статистики и ее инкрементальное обновление по журналу изменений
+VoterStats syncStats(sqlite3* db);
+
+// Число единичных битов в 64-битном слове
+int popcount64(uint64_t x);
+
+// Сжатое множество ID в стиле Roaring. Старшие 16 бит ID выбирают контейнер,
+// младшие хранятся в нем: до 4096 значений - отсортированным массивом,
+// больше - битовой картой на 65536 бит (8 КБ). Пересечение и объединение
+// выполняются по контейнерам с совпадающими старшими битами.
+class RoaringBitmap {
+    struct Container {
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> array;
+        std::vector<uint64_t> bits;
+
+        bool isBitmap() const { return !bits.empty(); }
+        bool contains(uint16_t low) const;
+        void toBitmap();
+        void toArray();
+        // Приведение к компактному представлению после изменения числа значений
+        void normalize();
+    };
+    std::vector<Container> containers;   // Упорядочены по старшим битам
+
+    std::vector<Container>::iterator find(uint16_t key);
+
+public:
+    void add(uint32_t id);
+
+    void remove(uint32_t id);
+
+    bool empty() const { return containers.empty(); }
+
+    uint64_t cardinality() const;
+
+    // Все ID множества в порядке возрастания
+    std::vector<uint32_t> values() const;
+
+    // Пересечение множеств
+    static RoaringBitmap intersect(const RoaringBitmap& a, const RoaringBitmap& b);
+
+    // Объединение множеств
+    static RoaringBitmap unite(const RoaringBitmap& a, const RoaringBitmap& b);
+
+    // Двоичная сериализация: массивы и битовые карты копируются целиком
+    // (в порядке байтов текущей машины - файл является локальным кешем)
+    void save(std::string& out) const;
+
+    bool load(const std::string& in, size_t& pos);
+};
+
+// Индексы в памяти: множество ID избирателей для каждого года рождения,
+// города рождения и улицы. Сохраняются в файл рядом с базой данных
+// ("имя.db.bitmaps") вместе с позицией журнала и догоняют журнал при открытии.
+struct BitmapIndex {
+    std::string db_name;
+    long long position = -1;
+    std::map<int, RoaringBitmap> years;
+    std::map<std::string, RoaringBitmap> cities, streets;
+
+    void clear();
+    void add(const User& u);
+    void remove(const User& u);
+    std::string save() const;
+    bool load(const std::string& in);
+};
+extern BitmapIndex bitmap_index;
+
+// Индекс по году рождения: плотный массив числа избирателей по годам
+// и префиксные суммы, поэтому число избирателей за год или диапазон лет
+// находится за O(1). Строится по битовым картам годов после каждой их
+// актуализации; списки ID для года берутся из bitmap_index.years.
+struct YearIndex {
+    int first_year = 0;
+    std::vector<int64_t> counts;     // counts[i] - число родившихся в году first_year + i
+    std::vector<int64_t> prefix;     // prefix[i] - сумма counts[0..i-1]
+
+    void build(const std::map<int, RoaringBitmap>& years);
+    int lastYear() const { return first_year + static_cast<int>(counts.size()) - 1; }
+    int64_t total() const { return prefix.back(); }
+    // Число избирателей, родившихся с from по to включительно
+    int64_t countRange(int from, int to) const;
+    int64_t count(int year) const { return countRange(year, year); }
+};
+extern YearIndex year_index;
+
+// Сохранение индексов в файл рядом с базой. Позиция также записывается
+// в таблицу stats, чтобы журнал не очищался раньше, чем индексы его учтут.
+void saveBitmaps(sqlite3* db);
+
+// Построение индексов в памяти по всей таблице users
+void rebuildBitmaps(sqlite3* db);
+
+// Актуализация индексов: при первом обращении к базе они читаются из файла
+// (или строятся заново, если файла нет или он не совпадает с базой),
+// затем к ним применяются изменения из журнала
+void syncBitmaps(sqlite3* db);
+
+// Форматы выгрузки результатов запроса
+enum ExportFormat { FormatTable = 1, FormatCsv, FormatJson, FormatNdjson, FormatFixed };
+
+// Расширение файла для формата выгрузки
+std::string formatExtension(int format);
+
+// Буфер вывода большого размера: данные копируются в него напрямую из указателей,
+// которые возвращает SQLite, и сбрасываются в файл крупными последовательными блоками
+class OutputBuffer {
+    std::ostream& out;
+    std::vector<char> buf;
+    size_t used = 0;
+public:
+    OutputBuffer(std::ostream& out, size_t capacity) : out(out), buf(capacity) {}
+    ~OutputBuffer() { flush(); }
+    void put(const char* data, size_t len) {
+        if (used + len > buf.size()) flush();
+        if (len > buf.size()) {
+            out.write(data, len);
+            return;
+        }
+        memcpy(buf.data() + used, data, len);
+        used += len;
+    }
+    void put(const char* str) { put(str, strlen(str)); }
+    void put(char c) {
+        if (used == buf.size()) flush();
+        buf[used++] = c;
+    }
+    void flush() {
+        if (used > 0) out.write(buf.data(), used);
+        used = 0;
+    }
+};
+
+// Поле CSV по RFC 4180: кавычки добавляются, только если поле содержит запятую,
+// кавычку или перевод строки; кавычки внутри поля удваиваются
+void putCsvField(OutputBuffer& out, const char* text, size_t len);
+
+// Строка JSON: экранируются кавычки, обратная косая черта и управляющие символы,
+// остальные байты UTF-8 копируются как есть
+void putJsonString(OutputBuffer& out, const char* text, size_t len);
+
+// Построчная запись в CSV, JSON-массив или NDJSON: заголовок CSV и ключи JSON
+// формируются один раз по именам столбцов, значения копируются в буфер без
+// промежуточных строк. Используется выгрузкой запросов и отчетом по фильтрам.
+class RowWriter {
+    OutputBuffer& out;
+    int format;
+    std::vector<std::string> keys;
+    long long count = 0;
+public:
+    RowWriter(OutputBuffer& out, int format, const std::vector<std::string>& names);
+
+    void beginRow();
+    // Значение столбца i; text == nullptr означает NULL
+    void value(int i, const char* text, size_t len, bool number);
+    void endRow();
+
+    // Строка из столбцов users (или первых из них, если столбцов меньше)
+    void user(const User& u);
+
+    // Завершение выгрузки (закрывающая скобка JSON-массива)
+    void finish();
+
+    long long rows() const { return count; }
+};
+
+// Потоковая выгрузка результата запроса в CSV, JSON-массив или NDJSON.
+// Строки берутся из курсора, имена столбцов - из подготовленного запроса.
+// Возвращает число записанных строк или -1 при ошибке.
+long long exportRows(const std::string& filename, ResultCursor& rows, int format);
+
+// Очередь ограниченной емкости между стадиями фоновой выгрузки.
+// После close() новые элементы не принимаются, а оставшиеся можно дочитать.
+template <typename T>
+class BoundedQueue {
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+    std::mutex m;
+    std::condition_variable not_empty, not_full;
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(m);
+        not_full.wait(lock, [&] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(m);
+        not_empty.wait(lock, [&] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+    void close() {
+        std::lock_guard<std::mutex> lock(m);
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+};
+
+// Фоновая выгрузка результата запроса в файл.
+// Три потока связаны очередями ограниченной емкости: первый выполняет запрос
+// на собственном подключении, второй форматирует строки в буферы по ~1 МБ,
+// третий последовательно записывает буферы в файл. Запрос читается в одной
+// транзакции, поэтому отчет регистрируется с позицией журнала на момент чтения.
+// Запускается только для баз в режиме WAL: в режиме DELETE эта транзакция
+// блокировала бы изменения базы на все время выгрузки.
+class ExportJob {
+public:
+    enum State { Running, Done, Cancelled, Failed };
+    const int id;
+    const std::string filename;
+    std::atomic<long long> rows{ 0 };
+    std::atomic<long long> bytes{ 0 };
+    std::atomic<int> state{ Running };
+
+    ExportJob(int id, const std::string& db_name, const std::string& sql, const std::string& filename, const std::string& kind, const std::string& param);
+    ~ExportJob();
+    void cancel();
+    void wait();
+    double seconds() const;
+private:
+    const std::string db_name, sql, kind, param;
+    BoundedQueue<std::vector<User>> row_queue;
+    BoundedQueue<std::pair<std::string, long long>> text_queue;
+    std::atomic<bool> cancelled{ false };
+    std::atomic<bool> read_ok{ false };
+    std::atomic<long long> position{ 0 };
+    std::chrono::steady_clock::time_point started, finished;
+    std::thread producer, formatter, writer;
+
+    void produce();
+
+    void format();
+
+    void writeOut();
+
+    // Имя удержания в stats: "export:<процесс>:<файл>" (см. clearStaleHolds)
+    std::string holdName() const;
+
+    // Снятие удержания журнала; при успехе отчет регистрируется на позиции снимка
+    // в той же транзакции, поэтому журнал между ними не очищается
+    void releaseJournal(bool registered);
+};
+
+// Удаление пользователя по ID из базы данных (файлы отчетов обновляются по журналу)
+void deleteUserById(sqlite3* db, int id);
+
+// Внешняя сортировка файла отчета. Строки читаются конвейером и копятся
+// порциями по sort_run_rows строк; каждая порция сортируется и записывается
+// во временный файл, затем временные файлы сливаются за один проход
+// через кучу по ключам сортировки. Память ограничена одной порцией
+// независимо от размера файла. Возвращает число строк или -1 при ошибке.
+const size_t sort_run_rows = 50000;
+
+long long externalSortReport(const std::string& source, const std::string& target, const std::vector<SortKey>& keys);
+
+// Разбор и проверка одной строки файла импорта по тем же правилам, что и при ручном вводе.
+// Формат строки: Фамилия;Имя;Отчество;Год рождения;Улица Дом Квартира;Место рождения
+bool parseImportLine(const std::string& line, User& u, std::string& error);
+
+// Параллельный импорт избирателей из файла.
+// Файл делится на фрагменты по границам строк, рабочие потоки разбирают и проверяют
+// фрагменты независимо, а вызывающий поток как единственный писатель вставляет
+// готовые фрагменты в базу строго по порядку, по одной транзакции на фрагмент.
+// Число разобранных, но еще не записанных фрагментов ограничено, чтобы память не росла.
+bool importVoters(sqlite3* db, const std::string& filename);
+
+// Заполнение таблицы users count случайными избирателями (одной транзакцией).
+// При одинаковом seed получаются одинаковые данные; используется проверкой
+// атомарности отчетов и замерами производительности.
+void generateVoters(sqlite3* db, int count, unsigned seed);
+
+// Наименьшая строка, большая всех строк с данным префиксом при побайтовом сравнении.
+// Пустой результат означает, что верхней границы нет.
+std::string prefixSuccessor(std::string prefix);
+
+// Замена первой строчной русской буквы на заглавную (фамилии и имена хранятся с заглавной)
+std::string capitalizeFirst(std::string str);
+
+// Префиксное дерево различных значений с количеством записей для автодополнения.
+// Дочерние узлы упорядочены по байтам, поэтому обход выдает значения в порядке сортировки базы.
+class NameTrie {
+    struct Node {
+        std::vector<std::pair<unsigned char, int>> children;
+        int64_t count = 0;      // Записей с ровно таким значением
+        int64_t subtotal = 0;   // Записей со значениями, начинающимися с этого префикса
+    };
+    std::vector<Node> nodes;
+
+    int child(int node, unsigned char c) const;
+    void collect(int node, std::string& name, size_t limit, std::vector<std::pair<std::string, int64_t>>& out) const;
+public:
+    NameTrie() : nodes(1) {}
+    void clear() { nodes.assign(1, Node()); }
+    // Учет count записей со значением name (отрицательное count - удаление записей)
+    void add(const std::string& name, int64_t count);
+    // Количество записей с данным префиксом
+    int64_t countPrefix(const std::string& prefix) const;
+    // Первые limit значений с данным префиксом в порядке сортировки
+    std::vector<std::pair<std::string, int64_t>> complete(const std::string& prefix, size_t limit) const;
+};
+
+// Получение актуального дерева автодополнения по фамилиям (field == 0) или именам
+const NameTrie& prefixTrie(sqlite3* db, int field);
+
+// Нормализация ФИО для нечеткого поиска: декодирование UTF-8, приведение
+// к строчным буквам и замена Ё на Е
+std::u32string normalizeName(const std::string& str);
+
+// Расстояние Левенштейна с ограничением: если оно больше limit, возвращается limit + 1
+int boundedEditDistance(const std::u32string& a, const std::u32string& b, int limit);
+
+// Триграммный индекс различных значений одного поля для нечеткого поиска.
+// Кандидаты отбираются по числу общих триграмм (слиянием списков вхождений),
+// затем проверяются ограниченным расстоянием Левенштейна.
+class TrigramIndex {
+    std::vector<std::string> values;
+    std::vector<std::u32string> normalized;
+    std::vector<int64_t> counts;                    // Число записей с таким значением
+    std::unordered_map<std::string, int> ids;
+    std::unordered_map<uint64_t, std::vector<int>> postings;
+
+    static std::vector<uint64_t> trigrams(const std::u32string& word);
+public:
+    void clear();
+    // Учет count записей со значением (отрицательное count - удаление). Значение,
+    // которого не осталось ни в одной записи, остается в индексе, но не находится.
+    void add(const std::string& value, int64_t count);
+    // Значения, отличающиеся от запроса не более чем на 1 (короткие слова) или 2 правки,
+    // упорядоченные по расстоянию
+    std::vector<std::pair<std::string, int>> search(const std::string& query, size_t limit) const;
+};
+
+// Триграммные индексы по фамилиям, именам и отчествам открытой базы данных.
+// Строятся при первом нечетком поиске и затем догоняют журнал изменений.
+struct FuzzyCache {
+    std::string db_name;
+    long long position = -1;
+    TrigramIndex fields[3];
+};
+
+// Получение актуальных триграммных индексов
+const FuzzyCache& fuzzyIndex(sqlite3* db);
+
+// Сравнение пользователей по естественному ключу (ФИО и год рождения)
+// в том же порядке, что и ORDER BY familiya, imya, otchestvo, godrozh
+int compareNaturalKey(const User& a, const User& b);
+
+// Запись списка пользователей в файл отчета
+void writeUsers(const std::string& filename, const std::vector<User>& users, FileBatch& batch);
+
+// Ключ секции для отчетов по секциям: место рождения, десятилетие рождения или улица
+std::string partitionKey(int by, const User& u);
+
+// Множество ID для одного условия фильтра: год или диапазон лет "1980-1989",
+// город рождения или улица
+RoaringBitmap bitmapTerm(int field, const std::string& value);
+
+// Запрос строк пользователей, ID которых загружены во временную таблицу filter_ids
+const char* const filter_query = "SELECT users.* FROM filter_ids JOIN users ON users.id = filter_ids.id ORDER BY filter_ids.id;";
+
+// Передача найденных по индексам ID в запрос через временную таблицу текущего подключения
+void loadFilterIds(sqlite3* db, const RoaringBitmap& ids);
+
+// Первая буква строки UTF-8 с точкой ("Иван" -> "И.")
+std::string initialOf(const std::string& str);
+
+// Сохранение профиля хранения в базе данных и его применение (с перестройкой страниц)
+bool setStorageProfile(sqlite3* db, const StorageProfile& p);
+
+// Время выполнения действия в миллисекундах
+template <typename F>
+long long measureMs(F action) {
+    auto started = std::chrono::steady_clock::now();
+    action();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+}
+
+// Проверка даты в формате ДД.ММ.ГГГГ
+bool isValidDate(const std::string& date);
+
+// Вывод возрастного состава по группам [bounds[i-1], bounds[i]); первая группа
+// без нижней границы, последняя - без верхней. Числа берутся из индекса годов за O(1) на группу.
+void writeAgeReport(std::ostream& out, const std::string& date, const std::vector<int>& bounds);
+
+// Схема таблицы избирателей
+const char* const users_table_sql = "CREATE TABLE IF NOT EXISTS users ("
+    "id INTEGER PRIMARY KEY AUTOINCREMENT, familiya TEXT NOT NULL, "
+    "imya TEXT NOT NULL, otchestvo TEXT NOT NULL, godrozh INTEGER NOT NULL, "
+    "adres TEXT NOT NULL, mesto TEXT NOT NULL);";
+
+// Разбиение строки сценария на слова; значения с пробелами заключаются в кавычки
+std::vector<std::string> splitCommand(const std::string& line);
+
+// Список файлов баз данных (.db) в каталоге в порядке имен
+std::vector<std::string> listDatabases(const std::string& dir);
+
+// Результат запроса к одной базе данных при поиске по нескольким базам.
+// Сами записи не хранятся: writeMerged читает их из баз построчно.
+struct SourceResult {
+    std::string file;
+    std::string name;            // Метка базы данных в выводе (имя файла без каталога и .db)
+    long long count = 0;
+    std::string error;
+    double ms = 0;
+};
+
+// Подключение к базе данных только для чтения и подготовка запроса с параметрами;
+// при ошибке возвращает false, а текст ошибки записывается в error
+bool openSource(const std::string& file, const std::string& sql, const std::vector<std::string>& params,
+    sqlite3*& db, sqlite3_stmt*& stmt, std::string& error);
+
+// Подсчет записей в одной базе данных на отдельном подключении только для чтения;
+// sql - запрос SELECT COUNT(*)
+void querySource(SourceResult& source, const std::string& sql, const std::vector<std::string>& params);
+
+// Вывод записей, найденных в нескольких базах данных, с меткой базы в каждой строке.
+// sql упорядочивает записи каждой базы по ФИО, году рождения и ID; запросы ко всем
+// базам открыты одновременно, и их строки объединяются слиянием через кучу,
+// поэтому в памяти находится не больше одной записи на базу.
+long long writeMerged(std::ostream& out, const std::vector<SourceResult>& sources, const std::string& sql,
+    const std::vector<std::string>& params, int name_width);